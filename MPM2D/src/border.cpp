@@ -1,55 +1,115 @@
 #include "border.h"
 
 /* Constructors */
-Border::Border(const int inType, const Vector2f& inNormal, const std::vector<Vector2f>& inX_corner)
+Border::Border(const int inType, const std::vector<Vector2f>& inX_corner)
 {
 	type = inType;
-	normal = inNormal;
 	X_corner = inX_corner;
 }
 
 
 
+/* -----------------------------------------------------------------------
+|							  GEOMETRY									 |
+----------------------------------------------------------------------- */
+
+
+void Border::ClosestPoint(const int s, const Vector2f& X, Vector2f& X_closest, bool& at_vertex) const
+{
+	Vector2f A = X_corner[s];
+	Vector2f AB = X_corner[s + 1] - A;
+
+	/* Projection parameter, clamped to the segment. */
+	double t = AB.dot(X - A) / AB.dot(AB);
+	at_vertex = (t <= 0) || (t >= 1);
+	t = std::clamp(t, 0.0, 1.0);
+
+	X_closest = A + t * AB;
+}
+
+
+Vector2f Border::SegmentNormal(const int s) const
+{
+	/* Left of the segment direction. */
+	Vector2f AB = X_corner[s + 1] - X_corner[s];
+	return Vector2f(-AB[1], AB[0]) / AB.norm();
+}
+
+
+
+/* At a vertex, the sign is given by the pseudo-normal (sum of the normals of the closest segments). */
+double Border::Distance(const Vector2f& X, Vector2f& X_closest, Vector2f& normal) const
+{
+	const double eps = 1e-10 * H * H;
+	double dist2 = -1;
+	Vector2f pseudo_normal;
+
+	for (int s = 0; s + 1 < (int)X_corner.size(); s++)
+	{
+		Vector2f X_s;
+		bool at_vertex;
+		ClosestPoint(s, X, X_s, at_vertex);
+
+		Vector2f d = X - X_s;
+		if (dist2 < 0 || d.dot(d) < dist2 - eps)
+		{
+			dist2 = d.dot(d);
+			X_closest = X_s;
+			pseudo_normal = SegmentNormal(s);
+		}
+		else if (d.dot(d) <= dist2 + eps)
+			pseudo_normal += SegmentNormal(s);
+	}
+
+	double dist = sqrt(dist2);
+	normal = pseudo_normal / pseudo_normal.norm();
+	if (dist <= 1e-8 * H)
+		return 0.0;
+
+	double sign = ((X - X_closest).dot(pseudo_normal) >= 0) ? 1.0 : -1.0;
+	normal = sign * (X - X_closest) / dist;
+	return sign * dist;
+}
+
+
+
 /* -----------------------------------------------------------------------
 |						 COLLISIONS / FRICTIONS							 |
 ----------------------------------------------------------------------- */
 
 
-void Border::Collision(const Vector2f& node_coordinates, Vector2f& node_velocity,
-	std::vector<int> &collision, const int b)
+bool Border::Collision(const double distance, const Vector2f& normal, const int type,
+	const Vector2f& boundary_velocity, Vector2f& node_velocity)
 {
-	/* Current distance between node and boundary. */
-	double distance = normal.dot(node_coordinates - X_corner[0]);
 	/* If the node is inside the boundary, and the boundary is sticky,
-	veclocity is 0 (motionless boundary). */
+	veclocity is the boundary velocity. */
 	if ((type == 1) && (distance < 0))
 	{
-		node_velocity = Vector2f(0);
+		node_velocity = boundary_velocity;
+		return false;
 	}
 
-	/* If not sticky, compute trial distance (after update of Xi). */
-	else
-	{
-		Vector2f trial_position = node_coordinates + DT * node_velocity;
-		double
-			trial_distance = normal.dot(trial_position - X_corner[0]);
-		double dist_c = trial_distance - std::min(distance, 0.0);
+	/* If not sticky, compute trial distance (after update of Xi, relative to the boundary). */
+	double trial_distance = distance + DT * normal.dot(node_velocity - boundary_velocity);
+	double dist_c = trial_distance - std::min(distance, 0.0);
 
-		/* Record collision and update node velocity. */
-		if (((type == 2) && (dist_c < 0)) || ((type == 3) && (distance < 0)))
-		{
-			node_velocity -= dist_c * normal / DT;
-			collision.push_back(b);
-		}
+	/* Record collision and update node velocity. */
+	if (((type == 2) && (dist_c < 0)) || ((type == 3) && (distance < 0)))
+	{
+		node_velocity -= dist_c * normal / DT;
+		return true;
 	}
+
+	return false;
 }
 
 
 /* Only for recorded collisions. */
-void Border::Friction(Vector2f& Vi_fri, const Vector2f& Vi_col, const Vector2f& Vi)
+void Border::Friction(const Vector2f& normal, const Vector2f& boundary_velocity,
+	Vector2f& Vi_fri, const Vector2f& Vi_col, const Vector2f& Vi)
 {
-	/* Compute tangential velocity. */
-	Vector2f Vt = Vi_col - normal * (normal.dot(Vi_fri));
+	/* Compute tangential velocity (relative to the boundary). */
+	Vector2f Vt = (Vi_col - boundary_velocity) - normal * (normal.dot(Vi_fri - boundary_velocity));
 	if (Vt.norm() > 1e-7)
 	{
 		Vector2f t = Vt / Vt.norm();
@@ -71,7 +131,10 @@ void Border::DrawBorder()
 	glColor3f(0.3f, 0.3f, 0.3f);
 
 	glBegin(GL_LINES);
-	glVertex2f(X_corner[0][0], X_corner[0][1]);
-	glVertex2f(X_corner[1][0], X_corner[1][1]);
+	for (size_t s = 0; s + 1 < X_corner.size(); s++)
+	{
+		glVertex2f(X_corner[s][0], X_corner[s][1]);
+		glVertex2f(X_corner[s + 1][0], X_corner[s + 1][1]);
+	}
 	glEnd();
 }
@@ -1,76 +1,111 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <vector>
 
 #include <GLFW\glfw3.h>
 
-#include "constants.h"
+#include "parameters.h"
 
-/* The border class defines the borders (lines in 2D).
-Interaction nodes-particles / borders defined here (collision, friction...). */
+/* The border class defines the borders (polylines in 2D).
+The domain is on the left of each segment: a closed counter-clockwise polygon encloses it.
+Borders are rasterized once per grid into a signed distance band (see Grid::RasterizeBorders),
+collisions and frictions are then computed per node from its distance and normal. */
+
+typedef uint64_t BorderMask;								// Collision record of a node (bit 0: borders)
 
 class Border
 {
 public:
 
 	/* Data */
-	Vector2f normal;										// UNIT vector normal to the plan
 	int type;												// [1] sticky - [2] Separating - [3] Sliding
 
-	std::vector<Vector2f> X_corner;							// Vertices of the border
+	std::vector<Vector2f> X_corner;							// Vertices of the polyline
 
 
 
 	/* Constructors */
 	Border() {};
-	Border(const int inType, const Vector2f& inNormal, const std::vector<Vector2f>& inX_corner);
+	Border(const int inType, const std::vector<Vector2f>& inX_corner);
 	~Border() {};
 
 
 
 	/* Functions */
-	void Collision(const Vector2f& node_coordinates,		// Apply collision with border object
-		Vector2f& node_velocity,
-		std::vector<int>& collision,
-		const int b);
-	void Friction(Vector2f& Vi_fri,							// Apply friction with border object
-		const Vector2f& Vi_col,
-		const Vector2f& Vi);
+	void ClosestPoint(const int s, const Vector2f& X,		// Closest point of segment s to X
+		Vector2f& X_closest, bool& at_vertex) const;
+	Vector2f SegmentNormal(const int s) const;				// Unit normal of segment s, pointing inside
+	double Distance(const Vector2f& X,						// Signed distance (> 0 inside), closest point and normal
+		Vector2f& X_closest, Vector2f& normal) const;
 
 	void DrawBorder();										// Draw border edges
 
 
 
 	/* Static Functions */
+	static bool Collision(const double distance,			// Apply collision (true if the node collides)
+		const Vector2f& normal,
+		const int type,
+		const Vector2f& boundary_velocity,					// Zero for borders, moving for colliders
+		Vector2f& node_velocity);
+	static void Friction(const Vector2f& normal,			// Apply friction (recorded collisions only)
+		const Vector2f& boundary_velocity,
+		Vector2f& Vi_fri,
+		const Vector2f& Vi_col,
+		const Vector2f& Vi);
+
 	static std::vector<Border> InitializeBorders()			// Initialize array of borders
 	{
 		std::vector<Border> outBorders;
 		std::vector<Vector2f> Corners;
 
-		/* Left border */
-		Corners.push_back(Vector2f(CUB, CUB));
-		Corners.push_back(Vector2f(CUB, Y_GRID -  CUB));
-		outBorders.push_back(Border(2, Vector2f(1, 0), Corners));
-		Corners.clear();
-		
-		/* Right border */
-		Corners.push_back(Vector2f(X_GRID - CUB, CUB));
-		Corners.push_back(Vector2f(X_GRID - CUB, Y_GRID - CUB));
-		outBorders.push_back(Border(2, Vector2f(-1, 0), Corners));
-		Corners.clear();
-
-		/* Bottom border */
-		Corners.push_back(Vector2f(CUB, CUB));
-		Corners.push_back(Vector2f(X_GRID - CUB, CUB));
-		outBorders.push_back(Border(2, Vector2f(0, 1), Corners));
-		Corners.clear();
-
-		/* Top border */
-		Corners.push_back(Vector2f(CUB, Y_GRID - CUB));
-		Corners.push_back(Vector2f(X_GRID - CUB, Y_GRID - CUB));
-		outBorders.push_back(Border(2, Vector2f(0, -1), Corners));
-		Corners.clear();
+		double x0 = CUB * H, x1 = X_DOMAIN - CUB * H;
+		double y0 = CUB * H, y1 = Y_DOMAIN - CUB * H;
+
+		if (!PERIODIC_X && !PERIODIC_Y)
+		{
+			/* Box */
+			Corners.push_back(Vector2f(x0, y0));
+			Corners.push_back(Vector2f(x1, y0));
+			Corners.push_back(Vector2f(x1, y1));
+			Corners.push_back(Vector2f(x0, y1));
+			Corners.push_back(Vector2f(x0, y0));
+			outBorders.push_back(Border(2, Corners));
+			Corners.clear();
+		}
+
+		// Periodic sides have no border (walls then span the whole period)
+		else if (!PERIODIC_Y)
+		{
+			/* Bottom border */
+			Corners.push_back(Vector2f(0.0, y0));
+			Corners.push_back(Vector2f(X_DOMAIN, y0));
+			outBorders.push_back(Border(2, Corners));
+			Corners.clear();
+
+			/* Top border */
+			Corners.push_back(Vector2f(X_DOMAIN, y1));
+			Corners.push_back(Vector2f(0.0, y1));
+			outBorders.push_back(Border(2, Corners));
+			Corners.clear();
+		}
+
+		else if (!PERIODIC_X)
+		{
+			/* Left border */
+			Corners.push_back(Vector2f(x0, Y_DOMAIN));
+			Corners.push_back(Vector2f(x0, 0.0));
+			outBorders.push_back(Border(2, Corners));
+			Corners.clear();
+
+			/* Right border */
+			Corners.push_back(Vector2f(x1, 0.0));
+			Corners.push_back(Vector2f(x1, Y_DOMAIN));
+			outBorders.push_back(Border(2, Corners));
+			Corners.clear();
+		}
 
 		return outBorders;
 	}
@@ -0,0 +1,72 @@
+#include "collider.h"
+
+/* Constructors */
+Collider::Collider(const int inType, const std::vector<Vector2f>& inX_body, const Vector2f& inX_start,
+	const Vector2f& inAmplitude, const double inFrequency, const double inOmega)
+{
+	type = inType;
+	X_body = inX_body;
+	X_start = inX_start;
+	amplitude = inAmplitude;
+	frequency = inFrequency;
+	omega = inOmega;
+
+	shape = Border(type, X_body);
+	Move(0.0);
+	X_min_old = X_min;
+	X_max_old = X_max;
+}
+
+
+
+/* -----------------------------------------------------------------------
+|								MOTION									 |
+----------------------------------------------------------------------- */
+
+
+void Collider::Move(const double t)
+{
+	X_min_old = X_min;
+	X_max_old = X_max;
+
+	double w = 2 * PI * frequency;
+	X_center = X_start + amplitude * sin(w * t);
+	V_center = amplitude * w * cos(w * t);
+
+	double c = cos(omega * t), s = sin(omega * t);
+	for (size_t v = 0; v < X_body.size(); v++)
+	{
+		Vector2f X = X_center + Vector2f(c * X_body[v][0] - s * X_body[v][1], s * X_body[v][0] + c * X_body[v][1]);
+		shape.X_corner[v] = X;
+
+		if (v == 0)
+		{
+			X_min = X;
+			X_max = X;
+		}
+		for (int d = 0; d < 2; d++)
+		{
+			X_min[d] = std::min(X_min[d], X[d]);
+			X_max[d] = std::max(X_max[d], X[d]);
+		}
+	}
+}
+
+
+Vector2f Collider::Velocity(const Vector2f& X) const
+{
+	Vector2f r = X - X_center;
+	return V_center + omega * Vector2f(-r[1], r[0]);
+}
+
+
+
+/* -----------------------------------------------------------------------
+|								DRAWING									 |
+----------------------------------------------------------------------- */
+
+
+void Collider::DrawCollider()
+{
+	shape.DrawBorder();
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+
+#include "border.h"
+
+/* The collider class defines kinematic solids (paddles, gates, mixers): rigid polygons with a
+prescribed motion, an oscillating translation of the center and a rotation at constant rate:
+	X_center(t) = X_start + amplitude * sin(2 pi frequency t),		angle(t) = omega * t.
+As for borders, the domain is on the left of the segments (clockwise polygon around the solid).
+Colliders are re-rasterized in the grid each step, over the nodes swept since the last step only
+(see Grid::RasterizeCollider). Their velocity enters the collision and friction of the nodes. */
+
+class Collider
+{
+public:
+
+	/* Data */
+	int type;												// [1] sticky - [2] Separating - [3] Sliding
+
+	std::vector<Vector2f> X_body;							// Vertices, relative to the center (body frame)
+	Vector2f X_start;										// Center at t = 0
+	Vector2f amplitude;										// Translation amplitude
+	double frequency;										// Translation frequency (Hz)
+	double omega;											// Angular velocity (rad/s)
+
+	Vector2f X_center;										// Current center
+	Vector2f V_center;										// Current velocity of the center
+	Border shape;											// Current vertices (world frame)
+
+	Vector2f X_min, X_max;									// Bounds of the current shape
+	Vector2f X_min_old, X_max_old;							// Bounds at the last step (nodes to forget)
+
+
+
+	/* Constructors */
+	Collider() {};
+	Collider(const int inType, const std::vector<Vector2f>& inX_body, const Vector2f& inX_start,
+		const Vector2f& inAmplitude, const double inFrequency, const double inOmega);
+	~Collider() {};
+
+
+
+	/* Functions */
+	void Move(const double t);								// Place the collider at time t
+	Vector2f Velocity(const Vector2f& X) const;				// Rigid body velocity at X
+
+	void DrawCollider();
+
+
+
+	/* Static Functions */
+	static std::vector<Collider> InitializeColliders()		// Initialize array of colliders
+	{
+		std::vector<Collider> outColliders;
+		if (!MOVING_COLLIDERS)
+			return outColliders;
+
+		std::vector<Vector2f> Corners;
+
+		/* Rotating mixer: a bar turning around its center */
+		double a = 0.15 * Y_DOMAIN, b = 2 * H;
+		Corners.push_back(Vector2f(-a, -b));
+		Corners.push_back(Vector2f(-a, b));
+		Corners.push_back(Vector2f(a, b));
+		Corners.push_back(Vector2f(a, -b));
+		Corners.push_back(Vector2f(-a, -b));
+		outColliders.push_back(Collider(2, Corners, Vector2f(0.5 * X_DOMAIN, 0.3 * Y_DOMAIN),
+			Vector2f(0.0), 0.0, 2.0));
+		Corners.clear();
+
+		/* Paddle: a vertical plate moving back and forth */
+		a = 2 * H; b = 0.1 * Y_DOMAIN;
+		Corners.push_back(Vector2f(-a, -b));
+		Corners.push_back(Vector2f(-a, b));
+		Corners.push_back(Vector2f(a, b));
+		Corners.push_back(Vector2f(a, -b));
+		Corners.push_back(Vector2f(-a, -b));
+		outColliders.push_back(Collider(2, Corners, Vector2f(0.2 * X_DOMAIN, CUB * H + b),
+			Vector2f(0.1 * X_DOMAIN, 0.0), 0.5, 0.0));
+		Corners.clear();
+
+		return outColliders;
+	}
+};
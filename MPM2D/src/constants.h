@@ -7,13 +7,27 @@
 |									OPTIONS								 |
 ----------------------------------------------------------------------- */
 
-// Grid
-const static int X_GRID = 200;							// Size of the domain
-const static int Y_GRID = 100;
+// Grid (defaults, can be changed at runtime: see parameters.h)
+const static double X_SIZE = 200.0;						// Size of the domain (physical units)
+const static double Y_SIZE = 100.0;
+const static double CELL_SIZE = 1.0;					// Grid cell size h
+const static bool ADAPTIVE = false;						// Two-level adaptive grid (cubic interpolation only)
+const static bool PERIODIC[2] = { false, false };		// Periodic domain in x / y (no border on these sides)
+const static bool DOUBLE_BUFFER = false;				// Double-buffered grid (reset overlapped with particles)
+const static bool COLLIDERS = false;					// Moving kinematic colliders (see collider.h)
+const static int P2G_TYPE = 0;							// P2G: [0] Atomic - [1] Colored blocks - [2] Thread-private grids - [3] Gather - [4] Tiled
+const static bool SIMD = true;							// Vectorized transfer kernels (when the CPU supports AVX2, see simd.h)
+const static bool TASKS = false;						// Task graph step instead of phases (tiled P2G, see scheduler.h)
+const static bool BALANCE = false;						// Particle update split by measured cost (see partitioner.h)
+const static bool DETERMINISTIC = false;					// Node sums in a fixed order: results independent of the thread count
+const static bool ADAPTIVE_DT = false;					// Time-step chosen each step from CFL bounds (see Solver::ChooseTimeStep)
+const static int AFFINITY = 0;							// Thread pinning: [0] OS - [1] Compact - [2] Spread (see numa.h)
+const static int RANKS = 1;								// Processes, one slab of the domain each (see domain.h)
+const static int BLOCK_STEPS = 1;						// Steps advanced at once by cache-resident strips (see temporal.h)
 
 // Transfer
-#define INTERPOLATION 1									// [1] Cubic - [2] Quadratic
-const static double DT = 0.001;						// Time-step
+const static int INTERPOLATION = 1;						// [1] Cubic - [2] Quadratic (see spline.h)
+const static double TIME_STEP = 0.001;					// Time-step (fixed, see ADAPTIVE_DT)
 
 // Ouput
 #define RECORD_VIDEO false
@@ -31,44 +45,44 @@ const static double DT = 0.001;						// Time-step
 
 
 /* ----- GRID ----- */
-const static double H_INV = 1.0;
+const static int TILE = 8;								// Tile width (nodes) for active grid bookkeeping
+const static double BAND_WIDTH = 3.0;					// Width (cells) of the border band (>= CUB)
+const static double PRIVATE_GRID_BUDGET = 1024.0;		// Memory (MB) allowed for thread-private grids (P2G_TYPE 2)
+const static int HALO = 3;								// Ghost node columns on each side of a slab (>= stencil width - 1)
+const static int TIME_BLOCK_WIDTH = 32;					// Core width (cells) of the strips of temporal blocking (multiple of TILE)
 
 
-/* ----- TRANSFER ----- */
-#if INTERPOLATION == 1
-const static int CUB = 2;
-const static Vector2f Translation_xp = Vector2f(0.0);
-static const int bni = -1;
-static const double Dp_scal = 3.0;
+/* ----- LOAD BALANCING ----- */
+const static int PARTITION_BLOCK = 64;					// Particles per cost measure
+const static double PARTITION_SMOOTHING = 0.5;			// Weight of the previous cost of a block
+const static size_t FIRST_TOUCH_MIN = 1 << 20;			// Arrays (bytes) placed by parallel first touch
 
-#elif INTERPOLATION == 2
-const static double CUB = 1.5;
-const static Vector2f Translation_xp = Vector2f(0.5);
-static const int bni = 0;
-static const double Dp_scal = 4.0;
-#endif
+
+/* ----- TIME STEPPING ----- */
+const static double CFL_SPEED = 0.5;					// Adaptive time-step: cells travelled by the fastest particle
+const static double CFL_WAVE = 0.6;						// Cells travelled by the fastest elastic wave
+const static double DT_MAX = 0.01;						// Bounds of the adaptive time-step
+const static double DT_MIN = 1e-6;
+
+
+/* ----- ADAPTIVE GRID ----- */
+const static double REFINE_STRAIN_RATE = 2.0;			// Refine where the velocity gradient norm exceeds this
+const static int REFINE_HOLD = 60;						// Steps a tile stays refined after its last request
+const static int COARSE_PAD = 2;						// Padding cells of the coarse grid (coarse stencil reach)
 
 
 /* ----- RENDERING ----- */
-const static int X_WINDOW = 1400;						// Window size
-const static int Y_WINDOW = X_WINDOW * Y_GRID / X_GRID;
+const static int X_WINDOW = 1400;						// Window width (height follows the domain)
 
 #if RECORD_VIDEO || WRITE_TO_FILE
 const static int FPS = 30;								// Video frame rate
 const static double DT_render = 1.0 / FPS;
 #else
-const static double DT_render = DT * 30.0;				// Rate of frame rendered (OpenGL)
+const static double DT_render = TIME_STEP * 30.0;		// Rate of frame rendered (OpenGL)
 #endif				
 
 
 /* ----- MATERIAL POINTS ----- */
-//TODO correct friction call
-#if Material Water
-#define FRICTION false
-#else
-#define FRICTION true
-#endif
-
 const static Vector2f G = Vector2f(0.0f, -9.81);		// Gravity
 const static double CFRI = 0.3;							// Friction coefficient		
 
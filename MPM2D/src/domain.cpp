@@ -0,0 +1,240 @@
+#include "domain.h"
+
+/* Constructors */
+Domain::Domain(Transport* inTransport)
+{
+	transport = inTransport;
+	rank = transport->rank;
+	ranks = transport->size;
+
+	if (ranks > 1 && (ADAPTIVE_GRID || PERIODIC_X || TASK_GRAPH || TIME_BLOCK > 1 || ADAPTIVE_TIME_STEP))
+	{
+		std::cerr << "Multi-process runs do not support the adaptive grid, periodic x, the task graph,"
+			<< " temporal blocking or adaptive time-steps" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// A halo never reaches past the neighbour slab
+	if (ranks > 1 && (X_GRID + 1) / ranks < HALO)
+	{
+		std::cerr << "Slabs of " << (X_GRID + 1) / ranks << " nodes for " << ranks << " processes: at least "
+			<< HALO << " needed" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	x0 = SlabStart(rank, ranks);
+	x1 = SlabStart(rank + 1, ranks);
+	g0 = std::max(x0 - HALO, 0);
+	g1 = std::min(x1 - 1 + HALO, X_GRID);
+}
+
+
+
+/* -----------------------------------------------------------------------
+|								PARTICLES								 |
+----------------------------------------------------------------------- */
+
+
+// Stencil base in the domain (as Grid::StencilBase on the whole grid)
+int Domain::Owner(const Vector2f& Xp) const
+{
+	const double translation = (INTERPOLATION_MODE == 1) ? Spline<1>::Translation_xp : Spline<2>::Translation_xp;
+	int x = static_cast<int>(floor(Xp[0] * H_INV - translation));
+	x = std::min(std::max(x, 0), X_GRID);
+
+	int r = (int)((long long)x * ranks / (X_GRID + 1));
+	while (r > 0 && x < SlabStart(r, ranks))
+		r--;
+	while (r < ranks - 1 && x >= SlabStart(r + 1, ranks))
+		r++;
+	return r;
+}
+
+
+// Particles are not plain data (their vectors and matrices have virtual destructors): their
+// values are sent as doubles (Material::Pack) and read back into new particles
+template <class V>
+static void PackParticles(const V& P, std::vector<char>& out)
+{
+	std::vector<double> data;
+	for (size_t p = 0; p < P.size(); p++)
+		P[p].Pack(data);
+
+	out.resize(data.size() * sizeof(double));
+	if (!data.empty())
+		memcpy(out.data(), data.data(), out.size());
+}
+
+
+template <class V>
+static void UnpackParticles(const std::vector<char>& in, V& P)
+{
+	std::vector<double> data(in.size() / sizeof(double));
+	if (!data.empty())
+		memcpy(data.data(), in.data(), in.size());
+
+	const double* next = data.data();
+	const double* end = next + data.size();
+	while (next < end)
+		P.push_back(Material::Unpack(next));
+}
+
+
+void Domain::Scatter(std::vector<Material>& P) const
+{
+	if (ranks == 1)
+		return;
+
+	std::vector<char> out, in;
+	if (rank == 0)
+	{
+		std::vector<Material> own, other;
+		for (int r = 1; r < ranks; r++)
+		{
+			other.clear();
+			for (size_t p = 0; p < P.size(); p++)
+				if (Owner(P[p].Xp) == r)
+					other.push_back(P[p]);
+			PackParticles(other, out);
+			transport->SendRecv(r, out, -1, in);
+		}
+
+		for (size_t p = 0; p < P.size(); p++)
+			if (Owner(P[p].Xp) == 0)
+				own.push_back(P[p]);
+		P.swap(own);
+	}
+	else
+	{
+		transport->SendRecv(-1, out, 0, in);
+		P.clear();
+		UnpackParticles(in, P);
+	}
+}
+
+
+// Kept particles stay in order, arrivals are appended (left neighbour first)
+void Domain::Migrate(NumaVector<Material>& particles) const
+{
+	const int left = (rank > 0) ? rank - 1 : -1;
+	const int right = (rank < ranks - 1) ? rank + 1 : -1;
+
+	std::vector<Material> leaving[2];
+	size_t keep = 0;
+	for (size_t p = 0; p < particles.size(); p++)
+	{
+		int owner = Owner(particles[p].Xp);
+		if (owner == rank)
+			particles[keep++] = particles[p];
+		else
+			leaving[owner < rank ? 0 : 1].push_back(particles[p]);
+	}
+	particles.erase(particles.begin() + keep, particles.end());
+
+	std::vector<char> out, from_left, from_right;
+	PackParticles(leaving[0], out);
+	transport->SendRecv(left, out, right, from_right);
+	PackParticles(leaving[1], out);
+	transport->SendRecv(right, out, left, from_left);
+
+	UnpackParticles(from_left, particles);
+	UnpackParticles(from_right, particles);
+}
+
+
+
+/* -----------------------------------------------------------------------
+|								NODE HALOS								 |
+----------------------------------------------------------------------- */
+
+
+// Columns [a, b) of the domain, all rows, field after field
+static void PackNodes(const Grid& g, const int g0, const int a, const int b,
+	const NumaVector<double>* const* fields, const int nfields, std::vector<char>& out)
+{
+	out.resize((size_t)nfields * std::max(b - a, 0) * (g.ny + 1) * sizeof(double));
+	double* data = reinterpret_cast<double*>(out.data());
+
+	for (int f = 0; f < nfields; f++)
+		for (int y = 0; y <= g.ny; y++)
+			for (int x = a; x < b; x++)
+				*data++ = (*fields[f])[g.NodeIndex(x - g0, y)];
+}
+
+
+// Received columns [a, b): added (sums of P2G), or copied (velocities)
+static void UnpackNodes(Grid& g, const int g0, const int a, const int b,
+	NumaVector<double>* const* fields, const int nfields, const std::vector<char>& in, const bool add)
+{
+	if (in.empty())
+		return;
+
+	const double* data = reinterpret_cast<const double*>(in.data());
+
+	for (int f = 0; f < nfields; f++)
+		for (int y = 0; y <= g.ny; y++)
+			for (int x = a; x < b; x++)
+			{
+				size_t i = g.NodeIndex(x - g0, y);
+				(*fields[f])[i] = add ? (*fields[f])[i] + *data : *data;
+				data++;
+			}
+}
+
+
+// Left halo [g0, x0) to the left neighbour, which owns it. The right neighbour sends its left halo,
+// the HALO last owned columns here (and the other way around)
+void Domain::SumHalos(Grid& g) const
+{
+	if (ranks == 1)
+		return;
+
+	NumaVector<double>* fields[5] = { &g.Mi, &g.Vi[0], &g.Vi[1], &g.Fi[0], &g.Fi[1] };
+	const int left = (rank > 0) ? rank - 1 : -1;
+	const int right = (rank < ranks - 1) ? rank + 1 : -1;
+	std::vector<char> out, from_left, from_right;
+
+	PackNodes(g, g0, g0, x0, fields, 5, out);
+	transport->SendRecv(left, out, right, from_right);
+	PackNodes(g, g0, x1, g1 + 1, fields, 5, out);
+	transport->SendRecv(right, out, left, from_left);
+
+	UnpackNodes(g, g0, x1 - HALO, x1, fields, 5, from_right, true);
+	UnpackNodes(g, g0, x0, x0 + HALO, fields, 5, from_left, true);
+
+	// Nodes reached by the particles of the neighbours only: their tiles are updated (and cleared
+	// at the next reset) too
+	for (int y = 0; y <= g.ny; y++)
+	{
+		for (int x = x0; x < x1; x++)
+		{
+			if ((x >= x0 + HALO || left < 0) && (x < x1 - HALO || right < 0))
+				continue;
+
+			size_t i = g.NodeIndex(x - g0, y);
+			if (g.Mi[i] != 0 || g.Fi[0][i] != 0 || g.Fi[1][i] != 0)
+				g.ActivateRange(x - g0, x - g0, y, y);
+		}
+	}
+}
+
+
+// Owned columns in the halos of the neighbours: [x0, x0 + HALO) to the left, [x1 - HALO, x1) to the right
+void Domain::CopyHalos(Grid& g) const
+{
+	if (ranks == 1)
+		return;
+
+	NumaVector<double>* fields[4] = { &g.Vi_col[0], &g.Vi_col[1], &g.Vi_fri[0], &g.Vi_fri[1] };
+	const int left = (rank > 0) ? rank - 1 : -1;
+	const int right = (rank < ranks - 1) ? rank + 1 : -1;
+	std::vector<char> out, from_left, from_right;
+
+	PackNodes(g, g0, x0, x0 + HALO, fields, 4, out);
+	transport->SendRecv(left, out, right, from_right);
+	PackNodes(g, g0, x1 - HALO, x1, fields, 4, out);
+	transport->SendRecv(right, out, left, from_left);
+
+	UnpackNodes(g, g0, x1, g1 + 1, fields, 4, from_right, false);
+	UnpackNodes(g, g0, g0, x0, fields, 4, from_left, false);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "grid.h"
+#include "particle.h"
+#include "transport.h"
+
+/* Domain decomposition of a multi-process run. The domain is cut in slabs along x (long channels),
+one per process. A process owns the nodes [x0, x1) of the domain and the particles whose stencil
+base is in its slab, its grid covers the slab and HALO nodes on each side. In a step:
+	P2G					each process scatters its particles, halo nodes included
+	SumHalos			halo sums are sent to the owner of the nodes and added there
+	UpdateNodes			(owned nodes now have the contributions of all the particles)
+	CopyHalos			updated velocities are copied to the halos of the neighbours
+	G2P, UpdateParticles
+	Migrate				particles whose stencil base left the slab go to the neighbour
+Particles move less than a cell per step and slabs are at least HALO nodes wide: processes only
+exchange with their neighbours. Node x indices here are indices in the whole domain. */
+
+class Domain
+{
+public:
+
+	/* Data */
+	Transport* transport;
+	int rank;												// This process
+	int ranks;												// Number of processes (slabs)
+	int x0, x1;												// Owned nodes [x0, x1)
+	int g0, g1;												// Nodes of the grid of the process [g0, g1]
+
+
+
+	/* Constructors */
+	Domain() : transport(nullptr), rank(0), ranks(1), x0(0), x1(0), g0(0), g1(0) {};
+	Domain(Transport* inTransport);
+	~Domain() {};
+
+
+
+	/* Functions */
+	int Owner(const Vector2f& Xp) const;					// Process of a particle
+	void Scatter(std::vector<Material>& P) const;			// Particles created on process 0 sent to their owner
+	void SumHalos(Grid& g) const;							// Add the halo sums of the neighbours (after P2G)
+	void CopyHalos(Grid& g) const;							// Node velocities of the halos (after UpdateNodes)
+	void Migrate(NumaVector<Material>& particles) const;	// Send the particles that left the slab
+
+	double Sum(const double x) const						// Sum over all the processes
+	{
+		return transport ? transport->Sum(x) : x;
+	}
+
+
+
+	/* Static Functions */
+	static int SlabStart(const int r, const int ranks)		// First node of the slab of process r
+	{
+		return (int)((long long)(X_GRID + 1) * r / ranks);
+	}
+};
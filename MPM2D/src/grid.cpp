@@ -0,0 +1,795 @@
+#include "grid.h"
+
+/* Constructors */
+Grid::Grid(const int inX, const int inY, const double inH, const std::vector<Border>& inBorders,
+	const int inOffset, const int inOrigin)
+{
+	nx = inX; ny = inY;
+	offset[0] = inOffset - inOrigin;
+	offset[1] = inOffset;
+	h = inH; h_inv = 1.0 / inH;
+	periodic[0] = PERIODIC_X;
+	periodic[1] = PERIODIC_Y;
+
+	ilen = (size_t)(inX + 1) * (size_t)(inY + 1);
+
+	Mi.assign(ilen, 0.0);
+	for (int d = 0; d < 2; d++)
+	{
+		Vi[d].assign(ilen, 0.0);
+		Vi_col[d].assign(ilen, 0.0);
+		Vi_fri[d].assign(ilen, 0.0);
+		Fi[d].assign(ilen, 0.0);
+	}
+
+	CollisionObjects.assign(ilen, 0);
+
+	X_TILES = (inX + TILE) / TILE;
+	Y_TILES = (inY + TILE) / TILE;
+	TileActive.assign((size_t)X_TILES * Y_TILES, 0);
+	ActiveTiles.reserve(TileActive.size());
+
+	BuildBlocks();
+	RasterizeBorders(inBorders);
+}
+
+/* -----------------------------------------------------------------------
+|								ACTIVE TILES							 |
+----------------------------------------------------------------------- */
+
+
+void Grid::TileRange(const int t, int& x0, int& x1, int& y0, int& y1) const
+{
+	x0 = (t % X_TILES) * TILE;
+	y0 = (t / X_TILES) * TILE;
+	x1 = std::min(x0 + TILE, nx + 1);
+	y1 = std::min(y0 + TILE, ny + 1);
+}
+
+
+// Split a stencil node range [a0, a1] in two where it crosses a periodic side
+static int SplitRange(const int a0, const int a1, const int n, const bool wrap, int out[2][2])
+{
+	if (wrap && a0 < 0)
+	{
+		out[0][0] = a0 + n; out[0][1] = n - 1;
+		out[1][0] = 0; out[1][1] = a1;
+		return 2;
+	}
+	if (wrap && a1 >= n)
+	{
+		out[0][0] = a0; out[0][1] = n - 1;
+		out[1][0] = 0; out[1][1] = a1 - n;
+		return 2;
+	}
+
+	out[0][0] = a0; out[0][1] = a1;
+	return 1;
+}
+
+
+// Called from the P2G particle loop: a stencil spans at most 2 x 2 tiles
+template <int INTERP>
+void Grid::ActivateStencil(const int x_base, const int y_base, const int thread)
+{
+	int x_range[2][2], y_range[2][2];
+	int nx_range = SplitRange(x_base + Spline<INTERP>::bni, x_base + 2, nx, periodic[0], x_range);
+	int ny_range = SplitRange(y_base + Spline<INTERP>::bni, y_base + 2, ny, periodic[1], y_range);
+
+	for (int j = 0; j < ny_range; j++)
+		for (int i = 0; i < nx_range; i++)
+			ActivateRange(x_range[i][0], x_range[i][1], y_range[j][0], y_range[j][1], thread);
+}
+
+template void Grid::ActivateStencil<1>(const int x_base, const int y_base, const int thread);
+template void Grid::ActivateStencil<2>(const int x_base, const int y_base, const int thread);
+
+
+void Grid::ActivateRange(int x0, int x1, int y0, int y1, const int thread)
+{
+	x0 = std::max(x0, 0); x1 = std::min(x1, nx);
+	y0 = std::max(y0, 0); y1 = std::min(y1, ny);
+
+	const int tx0 = x0 / TILE, tx1 = x1 / TILE;
+	const int ty0 = y0 / TILE, ty1 = y1 / TILE;
+
+	for (int ty = ty0; ty <= ty1; ty++)
+		for (int tx = tx0; tx <= tx1; tx++)
+		{
+			int t = ty * X_TILES + tx;
+			unsigned char active;
+
+			// Read first to keep the cache line shared when the tile is already marked
+			#pragma omp atomic read
+			active = TileActive[t];
+			if (!active)
+			{
+				#pragma omp atomic write
+				TileActive[t] = 1;
+			}
+
+			// Tiles of the private grid of the thread (only written by this thread)
+			if (thread >= 0)
+				PrivateTiles[thread][t] = 1;
+		}
+}
+
+
+void Grid::BuildActiveTiles()
+{
+	ActiveTiles.clear();
+	for (int t = 0, tlen = (int)TileActive.size(); t < tlen; t++)
+		if (TileActive[t])
+			ActiveTiles.push_back(t);
+}
+
+
+
+// A block holds the particles whose stencil base is in it, they write nodes [base + bni, base + 2].
+// Blocks are at least TILE >= 4 nodes wide: two blocks of the same parity in x (or y) are far enough
+// apart to never write the same node, which gives 4 colors. The last block takes the remainder of
+// the axis. On a periodic axis with an odd number of blocks, the last block and the first one
+// meet across the side and have the same parity: the last one gets a third color (up to 9 colors).
+void Grid::BuildBlocks()
+{
+	X_BLOCKS = std::max(nx / TILE, 1);
+	Y_BLOCKS = std::max(ny / TILE, 1);
+
+	int x_colors = (periodic[0] && X_BLOCKS > 1 && X_BLOCKS % 2) ? 3 : 2;
+	int y_colors = (periodic[1] && Y_BLOCKS > 1 && Y_BLOCKS % 2) ? 3 : 2;
+	colors = x_colors * y_colors;
+
+	for (int c = 0; c < 9; c++)
+		ColorBlocks[c].clear();
+
+	for (int by = 0; by < Y_BLOCKS; by++)
+		for (int bx = 0; bx < X_BLOCKS; bx++)
+		{
+			int cx = (x_colors == 3 && bx == X_BLOCKS - 1) ? 2 : bx % 2;
+			int cy = (y_colors == 3 && by == Y_BLOCKS - 1) ? 2 : by % 2;
+			ColorBlocks[cy * x_colors + cx].push_back(by * X_BLOCKS + bx);
+		}
+}
+
+
+
+// The last block of an axis also holds the remainder (and the wrapped bases of a periodic axis)
+void Grid::BlockRange(const int b, int& x0, int& x1, int& y0, int& y1) const
+{
+	int bx = b % X_BLOCKS, by = b / X_BLOCKS;
+
+	x0 = bx * TILE;
+	y0 = by * TILE;
+	x1 = (bx == X_BLOCKS - 1) ? nx : x0 + TILE - 1;
+	y1 = (by == Y_BLOCKS - 1) ? ny : y0 + TILE - 1;
+}
+
+
+
+/* -----------------------------------------------------------------------
+|							THREAD-PRIVATE GRIDS						 |
+----------------------------------------------------------------------- */
+
+
+// Each thread allocates (first touch) and owns its copy
+void Grid::AllocatePrivate(const int threads)
+{
+	PrivateM.resize(threads);
+	PrivateTiles.resize(threads);
+	for (int d = 0; d < 2; d++)
+	{
+		PrivateV[d].resize(threads);
+		PrivateF[d].resize(threads);
+	}
+
+	#pragma omp parallel for schedule (static, 1)
+	for (int t = 0; t < threads; t++)
+	{
+		PrivateM[t].assign(ilen, 0.0);
+		PrivateTiles[t].assign(TileActive.size(), 0);
+		for (int d = 0; d < 2; d++)
+		{
+			PrivateV[d][t].assign(ilen, 0.0);
+			PrivateF[d][t].assign(ilen, 0.0);
+		}
+	}
+}
+
+
+// Parallel over the active tiles: a tile sums the copies of the threads that wrote it (in thread
+// order) and clears them. No two threads write the same node, so no atomics are needed
+void Grid::ReducePrivate()
+{
+	const int threads = (int)PrivateM.size();
+
+	#pragma omp for schedule (dynamic)
+	for (int a = 0; a < (int)ActiveTiles.size(); a++)
+	{
+		const int tile = ActiveTiles[a];
+		int x0, x1, y0, y1;
+		TileRange(tile, x0, x1, y0, y1);
+
+		for (int t = 0; t < threads; t++)
+		{
+			if (!PrivateTiles[t][tile])
+				continue;
+			PrivateTiles[t][tile] = 0;
+
+			for (int y = y0; y < y1; y++)
+				for (size_t i = NodeIndex(x0, y), end = NodeIndex(x1, y); i < end; i++)
+				{
+					Mi[i] += PrivateM[t][i];
+					PrivateM[t][i] = 0.0;
+					for (int d = 0; d < 2; d++)
+					{
+						Vi[d][i] += PrivateV[d][t][i];
+						Fi[d][i] += PrivateF[d][t][i];
+						PrivateV[d][t][i] = 0.0;
+						PrivateF[d][t][i] = 0.0;
+					}
+				}
+		}
+	}
+}
+
+
+
+/* -----------------------------------------------------------------------
+|							TILE SCRATCHPADS							 |
+----------------------------------------------------------------------- */
+
+
+// The scratchpad of a tile covers the stencils of its bases: nodes x0 + bni to x1 + 1
+template <int INTERP>
+void Grid::LoadScratchpad(const int t, Scratchpad& pad, const NumaVector<double>* V) const
+{
+	int x0, x1, y0, y1;
+	TileRange(t, x0, x1, y0, y1);
+
+	pad.x0 = x0 + Spline<INTERP>::bni;
+	pad.y0 = y0 + Spline<INTERP>::bni;
+	pad.nx = periodic[0] ? nx : 0;
+	pad.ny = periodic[1] ? ny : 0;
+
+	if (!V)
+	{
+		pad.Clear();
+		return;
+	}
+
+	for (int y = pad.y0; y <= y1 + 1; y++)
+	{
+		if (!periodic[1] && (y < 0 || y > ny))
+			continue;
+
+		for (int x = pad.x0; x <= x1 + 1; x++)
+		{
+			if (!periodic[0] && (x < 0 || x > nx))
+				continue;
+
+			size_t i = StencilNode(x, y), l = pad.Index(x, y);
+			pad.V[0][l] = V[0][i];
+			pad.V[1][l] = V[1][i];
+		}
+	}
+}
+
+
+// Nodes [x0 + 2, x1 + bni - 1] of a tile are out of reach of the neighbour tiles: only this tile
+// writes them, with plain adds. The halo shared with the neighbours is added atomically
+template <int INTERP>
+void Grid::FlushScratchpad(const int t, const Scratchpad& pad)
+{
+	const int bni = Spline<INTERP>::bni;
+	int x0, x1, y0, y1;
+	TileRange(t, x0, x1, y0, y1);
+
+	for (int y = pad.y0; y <= y1 + 1; y++)
+	{
+		if (!periodic[1] && (y < 0 || y > ny))
+			continue;
+		const bool inner_y = (y >= y0 + 2 && y < y1 + bni);
+
+		for (int x = pad.x0; x <= x1 + 1; x++)
+		{
+			if (!periodic[0] && (x < 0 || x > nx))
+				continue;
+
+			// Nodes out of reach of the particles of the tile
+			size_t l = pad.Index(x, y);
+			if (pad.M[l] == 0.0)
+				continue;
+
+			size_t i = StencilNode(x, y);
+			if (inner_y && x >= x0 + 2 && x < x1 + bni)
+			{
+				Mi[i] += pad.M[l];
+				for (int d = 0; d < 2; d++)
+				{
+					Vi[d][i] += pad.V[d][l];
+					Fi[d][i] += pad.F[d][l];
+				}
+			}
+			else
+			{
+				#pragma omp atomic
+				Mi[i] += pad.M[l];
+				for (int d = 0; d < 2; d++)
+				{
+					#pragma omp atomic
+					Vi[d][i] += pad.V[d][l];
+					#pragma omp atomic
+					Fi[d][i] += pad.F[d][l];
+				}
+			}
+		}
+	}
+}
+
+// Deterministic flush: the scratchpads are kept and each node adds them in the order of the bins.
+// One writer per node and a fixed summation order, whatever the thread that filled a scratchpad
+void Grid::SumScratchpads(const int t, const std::vector<Scratchpad>& pads, const int* bins, const int count)
+{
+	int x0, x1, y0, y1;
+	TileRange(t, x0, x1, y0, y1);
+
+	for (int y = y0; y < y1; y++)
+	{
+		for (int x = x0; x < x1; x++)
+		{
+			// Last node of a periodic axis: image of node 0
+			if ((periodic[0] && x == nx) || (periodic[1] && y == ny))
+				continue;
+
+			size_t i = NodeIndex(x, y);
+			for (int k = 0; k < count; k++)
+			{
+				const Scratchpad& pad = pads[bins[k]];
+				int l = pad.Slot(x, y);
+				if (l < 0 || pad.M[l] == 0.0)
+					continue;
+
+				Mi[i] += pad.M[l];
+				for (int d = 0; d < 2; d++)
+				{
+					Vi[d][i] += pad.V[d][l];
+					Fi[d][i] += pad.F[d][l];
+				}
+			}
+		}
+	}
+}
+
+
+// Tiles of the nodes on one axis of a scratchpad: at most 3, as the halo is narrower than a tile
+static int AxisTiles(const int a0, const int a1, const int n, const bool wrap, int out[3])
+{
+	int count = 0;
+	for (int a = a0; a <= a1; a++)
+	{
+		if (!wrap && (a < 0 || a > n))
+			continue;
+
+		int tile = (wrap ? Grid::Wrap(a, n) : a) / TILE;
+		if (std::find(out, out + count, tile) == out + count)
+			out[count++] = tile;
+	}
+	return count;
+}
+
+
+// Same node ranges as LoadScratchpad: the tiles written by the flush of tile t, and read by its G2P
+template <int INTERP>
+int Grid::ScratchpadTiles(const int t, int tiles[9]) const
+{
+	int x0, x1, y0, y1;
+	TileRange(t, x0, x1, y0, y1);
+
+	int tx[3], ty[3];
+	int xlen = AxisTiles(x0 + Spline<INTERP>::bni, x1 + 1, nx, periodic[0], tx);
+	int ylen = AxisTiles(y0 + Spline<INTERP>::bni, y1 + 1, ny, periodic[1], ty);
+
+	for (int j = 0; j < ylen; j++)
+		for (int i = 0; i < xlen; i++)
+			tiles[j * xlen + i] = ty[j] * X_TILES + tx[i];
+	return xlen * ylen;
+}
+
+template void Grid::LoadScratchpad<1>(const int t, Scratchpad& pad, const NumaVector<double>* V) const;
+template void Grid::LoadScratchpad<2>(const int t, Scratchpad& pad, const NumaVector<double>* V) const;
+template void Grid::FlushScratchpad<1>(const int t, const Scratchpad& pad);
+template void Grid::FlushScratchpad<2>(const int t, const Scratchpad& pad);
+template int Grid::ScratchpadTiles<1>(const int t, int tiles[9]) const;
+template int Grid::ScratchpadTiles<2>(const int t, int tiles[9]) const;
+
+
+
+/* -----------------------------------------------------------------------
+|							BORDER RASTERIZATION						 |
+----------------------------------------------------------------------- */
+
+
+// Node range of the bounding box of a segment, grown by the band width
+static void SegmentRange(const Grid& g, const Border& border, const int s,
+	int& x0, int& x1, int& y0, int& y1)
+{
+	const Vector2f& A = border.X_corner[s];
+	const Vector2f& B = border.X_corner[s + 1];
+
+	g.BoxRange(Vector2f(std::min(A[0], B[0]), std::min(A[1], B[1])),
+		Vector2f(std::max(A[0], B[0]), std::max(A[1], B[1])), x0, x1, y0, y1);
+}
+
+
+// Done once: every segment visits the nodes of its bounding box grown by the band width.
+// At a vertex, the sign is taken from the pseudo-normal (sum of the adjacent segment normals),
+// which classifies nodes correctly around non-convex corners.
+void Grid::RasterizeBorders(const std::vector<Border>& inBorders)
+{
+	const double band = BAND_WIDTH * h;
+	const double eps = 1e-10 * h * h;
+	int x0, x1, y0, y1;
+
+	// Pass 1: squared distance to the closest segment
+	std::vector<double> Dist2(ilen, band * band);
+	for (size_t b = 0; b < inBorders.size(); b++)
+		for (int s = 0; s + 1 < (int)inBorders[b].X_corner.size(); s++)
+		{
+			SegmentRange(*this, inBorders[b], s, x0, x1, y0, y1);
+
+			for (int y = y0; y <= y1; y++)
+				for (int x = x0; x <= x1; x++)
+				{
+					Vector2f X_closest;
+					bool at_vertex;
+					size_t i = NodeIndex(x, y);
+					inBorders[b].ClosestPoint(s, NodePosition(i), X_closest, at_vertex);
+
+					Vector2f d = NodePosition(i) - X_closest;
+					Dist2[i] = std::min(Dist2[i], d.dot(d));
+				}
+		}
+
+	// Band nodes
+	BandIndex.assign(ilen, -1);
+	int band_len = 0;
+	for (size_t i = 0; i < ilen; i++)
+		if (Dist2[i] < band * band)
+			BandIndex[i] = band_len++;
+
+	BandPhi.assign(band_len, 0.0);
+	BandNormal[0].assign(band_len, 0.0);
+	BandNormal[1].assign(band_len, 0.0);
+	BandType.assign(band_len, 0);
+	std::vector<Vector2f> Closest(band_len);
+	std::vector<Vector2f> PseudoNormal(band_len);
+
+	// Pass 2: closest point, type, and sum of the normals of the segments at that distance
+	for (size_t b = 0; b < inBorders.size(); b++)
+		for (int s = 0; s + 1 < (int)inBorders[b].X_corner.size(); s++)
+		{
+			SegmentRange(*this, inBorders[b], s, x0, x1, y0, y1);
+
+			for (int y = y0; y <= y1; y++)
+				for (int x = x0; x <= x1; x++)
+				{
+					size_t i = NodeIndex(x, y);
+					int k = BandIndex[i];
+					if (k < 0)
+						continue;
+
+					Vector2f X_closest;
+					bool at_vertex;
+					inBorders[b].ClosestPoint(s, NodePosition(i), X_closest, at_vertex);
+
+					Vector2f d = NodePosition(i) - X_closest;
+					if (d.dot(d) > Dist2[i] + eps)
+						continue;
+
+					if (!BandType[k])
+					{
+						BandType[k] = inBorders[b].type;
+						Closest[k] = X_closest;
+					}
+					PseudoNormal[k] += inBorders[b].SegmentNormal(s);
+				}
+		}
+
+	// Signed distance and unit normal pointing inside the domain
+	for (size_t i = 0; i < ilen; i++)
+	{
+		int k = BandIndex[i];
+		if (k < 0)
+			continue;
+
+		Vector2f d = NodePosition(i) - Closest[k];
+		double dist = sqrt(Dist2[i]);
+		Vector2f normal = PseudoNormal[k] / PseudoNormal[k].norm();
+
+		if (dist > 1e-8 * h)
+		{
+			double sign = (d.dot(PseudoNormal[k]) >= 0) ? 1.0 : -1.0;
+			normal = sign * d / dist;
+			BandPhi[k] = sign * dist;
+		}
+
+		BandNormal[0][k] = normal[0];
+		BandNormal[1][k] = normal[1];
+	}
+}
+
+
+void Grid::BoxRange(const Vector2f& X_min, const Vector2f& X_max, int& x0, int& x1, int& y0, int& y1) const
+{
+	const double band = BAND_WIDTH * h;
+
+	x0 = std::max(static_cast<int>(floor((X_min[0] - band) * h_inv)) + offset[0], 0);
+	x1 = std::min(static_cast<int>(ceil((X_max[0] + band) * h_inv)) + offset[0], periodic[0] ? nx - 1 : nx);
+	y0 = std::max(static_cast<int>(floor((X_min[1] - band) * h_inv)) + offset[1], 0);
+	y1 = std::min(static_cast<int>(ceil((X_max[1] + band) * h_inv)) + offset[1], periodic[1] ? ny - 1 : ny);
+}
+
+
+/* -----------------------------------------------------------------------
+|								COLLIDERS								 |
+----------------------------------------------------------------------- */
+
+
+void Grid::AllocateColliders()
+{
+	ColliderIndex.assign(ilen, -1);
+	ColliderPhi.assign(ilen, 0.0);
+	ColliderType.assign(ilen, 0);
+	for (int d = 0; d < 2; d++)
+	{
+		ColliderNormal[d].assign(ilen, 0.0);
+		ColliderV[d].assign(ilen, 0.0);
+	}
+}
+
+
+// Called over the box of the last step: all the nodes a collider can have written
+void Grid::ClearColliders(const Vector2f& X_min, const Vector2f& X_max)
+{
+	int x0, x1, y0, y1;
+	BoxRange(X_min, X_max, x0, x1, y0, y1);
+
+	#pragma omp for
+	for (int y = y0; y <= y1; y++)
+		for (int x = x0; x <= x1; x++)
+			ColliderIndex[NodeIndex(x, y)] = -1;
+}
+
+
+// Over the box of the current position only. Where colliders overlap, the deepest one is kept
+void Grid::RasterizeCollider(const int c, const Collider& collider)
+{
+	const double band = BAND_WIDTH * h;
+	int x0, x1, y0, y1;
+	BoxRange(collider.X_min, collider.X_max, x0, x1, y0, y1);
+
+	#pragma omp for
+	for (int y = y0; y <= y1; y++)
+		for (int x = x0; x <= x1; x++)
+		{
+			size_t i = NodeIndex(x, y);
+			Vector2f X_closest, normal;
+			double phi = collider.shape.Distance(NodePosition(i), X_closest, normal);
+
+			if (fabs(phi) >= band || (ColliderIndex[i] >= 0 && ColliderPhi[i] <= phi))
+				continue;
+
+			ColliderIndex[i] = c;
+			ColliderPhi[i] = phi;
+			Set(ColliderNormal, i, normal);
+			Set(ColliderV, i, collider.Velocity(X_closest));
+			ColliderType[i] = collider.type;
+		}
+}
+
+
+
+/* -----------------------------------------------------------------------
+|				 COLLISIONS / FRICTIONS  /  RESET						 |
+----------------------------------------------------------------------- */
+
+
+// Move a particle back on the boundary and remove its normal velocity into it
+static void ProjectOut(const double phi, Vector2f normal, const Vector2f& boundary_velocity,
+	Vector2f& X, Vector2f& V)
+{
+	if (normal.norm() < 1e-12)
+		return;
+	normal /= normal.norm();
+
+	X -= phi * normal;
+	double vn = normal.dot(V - boundary_velocity);
+	if (vn < 0)
+		V -= vn * normal;
+}
+
+
+// Collisions are applied on nodes only, a large time-step can move particles through a boundary.
+// The distance is interpolated (bilinear) in the cell of the particle, from the border band
+// and the collider data: particles away from the boundaries return at the first missing corner.
+void Grid::ProjectParticle(Vector2f& X, Vector2f& V) const
+{
+	double fx = X[0] * h_inv + offset[0], fy = X[1] * h_inv + offset[1];
+	int x = static_cast<int>(floor(fx)), y = static_cast<int>(floor(fy));
+	if (x < 0 || y < 0 || x >= nx || y >= ny)
+		return;
+
+	double ax = fx - x, ay = fy - y;
+	size_t id[4] = { StencilNode(x, y), StencilNode(x + 1, y), StencilNode(x, y + 1), StencilNode(x + 1, y + 1) };
+	double w[4] = { (1 - ax) * (1 - ay), ax * (1 - ay), (1 - ax) * ay, ax * ay };
+
+	// Borders
+	double phi = 0.0;
+	Vector2f normal;
+	int c = 0;
+	for (; c < 4 && BandIndex[id[c]] >= 0; c++)
+	{
+		int k = BandIndex[id[c]];
+		phi += w[c] * BandPhi[k];
+		normal += w[c] * Vector2f(BandNormal[0][k], BandNormal[1][k]);
+	}
+	if (c == 4 && phi < 0)
+		ProjectOut(phi, normal, Vector2f(0.0), X, V);
+
+	// Colliders
+	if (ColliderIndex.empty())
+		return;
+
+	phi = 0.0;
+	normal = Vector2f(0.0);
+	Vector2f velocity;
+	for (c = 0; c < 4 && ColliderIndex[id[c]] >= 0; c++)
+	{
+		phi += w[c] * ColliderPhi[id[c]];
+		normal += w[c] * Get(ColliderNormal, id[c]);
+		velocity += w[c] * Get(ColliderV, id[c]);
+	}
+	if (c == 4 && phi < 0)
+		ProjectOut(phi, normal, velocity, X, V);
+}
+
+
+// O(1): distance and normal come from the border band and the collider data
+void Grid::NodeCollisions(const size_t i)
+{
+	Vector2f V = Get(Vi, i);
+
+	int k = BandIndex[i];
+	if (k >= 0 && Border::Collision(BandPhi[k], Vector2f(BandNormal[0][k], BandNormal[1][k]),
+		BandType[k], Vector2f(0.0), V))
+		CollisionObjects[i] |= 1;
+
+	if (!ColliderIndex.empty() && ColliderIndex[i] >= 0 && Border::Collision(ColliderPhi[i],
+		Get(ColliderNormal, i), ColliderType[i], Get(ColliderV, i), V))
+		CollisionObjects[i] |= 2;
+
+	Set(Vi_col, i, V);
+}
+
+
+void Grid::NodeFrictions(const size_t i)
+{
+	Vector2f V = Get(Vi_col, i);
+
+	if (CollisionObjects[i] & 1)
+	{
+		int k = BandIndex[i];
+		Border::Friction(Vector2f(BandNormal[0][k], BandNormal[1][k]), Vector2f(0.0),
+			V, Get(Vi_col, i), Get(Vi, i));
+	}
+
+	if (CollisionObjects[i] & 2)
+		Border::Friction(Get(ColliderNormal, i), Get(ColliderV, i), V, Get(Vi_col, i), Get(Vi, i));
+
+	Set(Vi_fri, i, V);
+}
+
+
+// Memset of the accumulated fields of a tile, one tile row at a time
+static void ClearTile(const Grid& g, const int t, NumaVector<double>& M,
+	NumaVector<double> V[2], NumaVector<double> F[2], NumaVector<BorderMask>& C)
+{
+	int x0, x1, y0, y1;
+	g.TileRange(t, x0, x1, y0, y1);
+
+	for (int y = y0; y < y1; y++)
+	{
+		size_t begin = g.NodeIndex(x0, y);
+		size_t count = x1 - x0;
+
+		memset(&M[begin], 0, count * sizeof(double));
+		for (int d = 0; d < 2; d++)
+		{
+			memset(&V[d][begin], 0, count * sizeof(double));
+			memset(&F[d][begin], 0, count * sizeof(double));
+		}
+		memset(&C[begin], 0, count * sizeof(BorderMask));
+	}
+}
+
+
+// Over the active tiles only
+void Grid::ResetGrid()
+{
+	#pragma omp for
+	for (int a = 0; a < (int)ActiveTiles.size(); a++)
+	{
+		ClearTile(*this, ActiveTiles[a], Mi, Vi, Fi, CollisionObjects);
+		TileActive[ActiveTiles[a]] = 0;
+	}
+
+	#pragma omp single
+	ActiveTiles.clear();
+}
+
+
+void Grid::AllocateBackBuffer()
+{
+	Mi_back.assign(ilen, 0.0);
+	for (int d = 0; d < 2; d++)
+	{
+		Vi_back[d].assign(ilen, 0.0);
+		Fi_back[d].assign(ilen, 0.0);
+	}
+	CollisionObjects_back.assign(ilen, 0);
+	TileActive_back.assign(TileActive.size(), 0);
+	ActiveTiles_back.reserve(TileActive.size());
+}
+
+
+// No OpenMP construct here: called from the worksharing loop of UpdateParticles
+void Grid::ClearBackTile(const int a)
+{
+	ClearTile(*this, ActiveTiles_back[a], Mi_back, Vi_back, Fi_back, CollisionObjects_back);
+	TileActive_back[ActiveTiles_back[a]] = 0;
+}
+
+
+void Grid::SwapBuffers()
+{
+	ActiveTiles_back.clear();
+
+	Mi.swap(Mi_back);
+	for (int d = 0; d < 2; d++)
+	{
+		Vi[d].swap(Vi_back[d]);
+		Fi[d].swap(Fi_back[d]);
+	}
+	CollisionObjects.swap(CollisionObjects_back);
+	TileActive.swap(TileActive_back);
+	ActiveTiles.swap(ActiveTiles_back);
+}
+
+
+
+/* -----------------------------------------------------------------------
+|								RENDERING		     					 |
+----------------------------------------------------------------------- */
+
+
+void Grid::DrawNodes()
+{
+	glPointSize(3.0f);
+
+	glBegin(GL_POINTS);
+	for (size_t i = 0; i < ilen; i++)
+	{
+		if (Mi[i] > 0)
+		{
+			glColor3f(0.5f, 0.5f, 0.5f);
+		}
+		else
+		{
+			glColor3f(0.3f, 0.3f, 0.3f);
+		}
+
+		Vector2f Xi = NodePosition(i);
+		glVertex2f(Xi[0], Xi[1]);
+	}
+	glEnd();
+}
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <cstring>
+#include <iostream>
+
+#include "border.h"
+#include "collider.h"
+#include "parameters.h"
+#include "numa.h"
+
+/* The grid class defines the background grid.
+Node data is stored as a structure of arrays: one contiguous array per scalar
+component, indexed by node id = (nx + 1) * y + x. Node (x, y) is at ((x - offset[0]) * h, (y - offset[1]) * h).
+The base grid has offset 0, coarser levels (adaptive grid) are padded to keep their stencils inside.
+The grid of a process of a multi-process run covers its slab of the domain: its x offset is minus
+the first node of the slab (see domain.h).
+On a periodic axis, node nx is the image of node 0: stencil indices wrap to [0, nx). */
+
+struct Scratchpad;
+
+class Grid
+{
+public:
+
+	/* Data */
+	int nx, ny;											// Number of cells
+	int offset[2];										// Number of padding cells before the origin
+	double h, h_inv;									// Cell size
+	bool periodic[2];									// Periodic axes
+	size_t ilen;										// Number of nodes
+
+	NumaVector<double> Mi;								// Node mass
+	NumaVector<double> Vi[2];							// Node momentum, then velocity after update and force
+	NumaVector<double> Vi_col[2];						// Node velocity, after collision
+	NumaVector<double> Vi_fri[2];						// Node velocity, after friction
+
+	NumaVector<double> Fi[2];							// Force applied to the node
+
+	NumaVector<BorderMask> CollisionObjects;			// Collision record (bit 0: borders - bit 1: colliders)
+
+	// Borders rasterized in a narrow band (BAND_WIDTH cells): nodes away from the borders skip collisions
+	NumaVector<int> BandIndex;							// Index in the band arrays, -1 outside the band
+	std::vector<double> BandPhi;						// Signed distance to the borders (> 0 inside the domain)
+	std::vector<double> BandNormal[2];					// Unit normal of the closest border, pointing inside
+	std::vector<unsigned char> BandType;				// Type of the closest border
+
+	// Moving colliders, per node (allocated with colliders only): rewritten each step around the colliders
+	NumaVector<int> ColliderIndex;						// Closest collider, -1 if none
+	NumaVector<double> ColliderPhi;						// Signed distance to the collider (> 0 outside the solid)
+	NumaVector<double> ColliderNormal[2];				// Unit normal of the collider, pointing outside the solid
+	NumaVector<double> ColliderV[2];					// Velocity of the collider surface
+	NumaVector<unsigned char> ColliderType;
+
+	int X_TILES, Y_TILES;								// Number of TILE x TILE node blocks
+	std::vector<unsigned char> TileActive;				// Tile touched by a particle stencil in P2G
+	std::vector<int> ActiveTiles;						// Compact list of touched tiles
+
+	// Particle blocks of the colored P2G (blocks of a color never write the same nodes)
+	int X_BLOCKS, Y_BLOCKS;								// Number of blocks (stencil bases of >= TILE nodes)
+	std::vector<int> ColorBlocks[9];					// Blocks of each color
+	int colors;
+
+	// Thread-private copies of the accumulated fields (P2G by reduction), one per thread
+	std::vector<NumaVector<double>> PrivateM;
+	std::vector<NumaVector<double>> PrivateV[2];
+	std::vector<NumaVector<double>> PrivateF[2];
+	std::vector<std::vector<unsigned char>> PrivateTiles;	// Tiles written by each thread
+
+	// Back buffer of the accumulated fields (double-buffered grid): written in the previous
+	// step, cleared while particles read the front buffer, then swapped in for the next P2G
+	NumaVector<double> Mi_back;
+	NumaVector<double> Vi_back[2];
+	NumaVector<double> Fi_back[2];
+	NumaVector<BorderMask> CollisionObjects_back;
+	std::vector<unsigned char> TileActive_back;
+	std::vector<int> ActiveTiles_back;
+
+
+
+	/* Constructors */
+	Grid() {};
+	Grid(const int inX, const int inY, const double inH, const std::vector<Border>& inBorders,
+		const int inOffset = 0, const int inOrigin = 0);	// inOrigin: first node in x (slab of a process)
+	~Grid() {};
+
+
+
+	/* Functions */
+	size_t NodeIndex(const int x, const int y) const
+	{
+		return (size_t)(nx + 1) * y + x;
+	}
+
+	Vector2f NodePosition(const size_t i) const			// Node position (physical units), from its index
+	{
+		return Vector2f((double)((int)(i % (nx + 1)) - offset[0]) * h, (double)((int)(i / (nx + 1)) - offset[1]) * h);
+	}
+
+	Vector2f NodePosition(const int x, const int y) const	// Position of stencil node (x, y), not wrapped
+	{
+		return Vector2f((double)(x - offset[0]) * h, (double)(y - offset[1]) * h);
+	}
+
+	size_t StencilNode(int x, int y) const				// Index of stencil node (x, y), wrapped on periodic axes
+	{
+		if (periodic[0])
+			x = Wrap(x, nx);
+		if (periodic[1])
+			y = Wrap(y, ny);
+		return NodeIndex(x, y);
+	}
+
+	template <int INTERP>
+	bool ContiguousRows(const int x_base) const			// Stencil rows contiguous in memory (no periodic wrap in x)
+	{
+		return !periodic[0] || (x_base + Spline<INTERP>::bni >= 0 && x_base + 2 < nx);
+	}
+
+	void WrapPosition(Vector2f& X) const				// Bring a position back in the periodic domain
+	{
+		// Any distance (a particle of an unstable step may travel several periods), then [0, L)
+		// for the rounding of X - L floor(X / L) (a tiny negative X gives L)
+		for (int d = 0; d < 2; d++)
+		{
+			if (!periodic[d] || (X[d] >= 0 && X[d] < (d ? ny : nx) * h))
+				continue;
+			double L = (d ? ny : nx) * h;
+			X[d] = std::min(X[d] - L * floor(X[d] / L), std::nextafter(L, 0.0));
+		}
+	}
+
+	template <int INTERP>
+	void ClampParticle(Vector2f& X, Vector2f& V) const	// Keep the particle stencil inside the grid
+	{
+		typedef Spline<INTERP> S;
+
+		// Branch-free guard: [lo, hi] is the range of positions whose stencil is in [0, n]
+		// (min first: a NaN position is sent to hi). Periodic axes: the period [0, L) (stencils
+		// wrap), where WrapPosition leaves every finite position
+		for (int d = 0; d < 2; d++)
+		{
+			double lo = (S::Translation_xp - S::bni - offset[d]) * h;
+			double hi = ((d ? ny : nx) - 1 + S::Translation_xp - offset[d] - 1e-9) * h;
+			if (periodic[d])
+			{
+				lo = 0.0;
+				hi = std::nextafter((d ? ny : nx) * h, 0.0);
+			}
+			double Xc = std::max(lo, std::min(hi, X[d]));
+			V[d] = (Xc == X[d]) ? V[d] : 0.0;
+			X[d] = Xc;
+		}
+	}
+
+	template <int INTERP>
+	void StencilBase(const Vector2f& Xp,				// Bottom-left node of the particle stencil
+		int& x_base, int& y_base) const
+	{
+		x_base = static_cast<int>(floor(Xp[0] * h_inv - Spline<INTERP>::Translation_xp)) + offset[0];
+		y_base = static_cast<int>(floor(Xp[1] * h_inv - Spline<INTERP>::Translation_xp)) + offset[1];
+	}
+
+	void TileRange(const int t,							// Node range [x0, x1) x [y0, y1) of a tile
+		int& x0, int& x1, int& y0, int& y1) const;
+
+	template <int INTERP>
+	void ActivateStencil(const int x_base, const int y_base,	// Mark the tiles covered by a particle stencil
+		const int thread = -1);							// (and the private tiles of a thread)
+	void ActivateRange(int x0, int x1, int y0, int y1,	// Mark the tiles covering nodes [x0, x1] x [y0, y1]
+		const int thread = -1);
+	void BuildActiveTiles();							// Compact the touched tiles into ActiveTiles
+
+	void AllocatePrivate(const int threads);			// Thread-private grids
+	void ReducePrivate();								// Sum the private grids over the active tiles (*)
+
+	template <int INTERP>
+	void LoadScratchpad(const int t, Scratchpad& pad,	// Place the scratchpad on tile t: cleared (P2G),
+		const NumaVector<double>* V = nullptr) const;	// or holding the node velocities V (G2P)
+	template <int INTERP>
+	void FlushScratchpad(const int t, const Scratchpad& pad);	// Add the sums of the scratchpad of tile t
+	template <int INTERP>
+	int ScratchpadTiles(const int t, int tiles[9]) const;	// Tiles holding the nodes of the scratchpad of tile t
+	void SumScratchpads(const int t, const std::vector<Scratchpad>& pads,	// Add the scratchpads of bins to the
+		const int* bins, const int count);				// nodes of tile t, in the order of bins (*)
+
+	void BuildBlocks();									// Blocks and colors of the colored P2G
+	void BlockRange(const int b,						// Stencil bases [x0, x1] x [y0, y1] of a block
+		int& x0, int& x1, int& y0, int& y1) const;
+
+	void RasterizeBorders(const std::vector<Border>& inBorders);	// Signed distance band of the borders
+	void BoxRange(const Vector2f& X_min, const Vector2f& X_max,	// Nodes of a box grown by the band width
+		int& x0, int& x1, int& y0, int& y1) const;
+
+	void AllocateColliders();
+	void ClearColliders(const Vector2f& X_min, const Vector2f& X_max);	// Forget the colliders over a box (*)
+	void RasterizeCollider(const int c, const Collider& collider);	// Band of a collider at its current position (*)
+
+	void ProjectParticle(Vector2f& X, Vector2f& V) const;	// Push a particle that went through a boundary back
+
+	void NodeCollisions(const size_t i);				// Apply collision with the borders and colliders
+	void NodeFrictions(const size_t i);					// Apply friction if collision
+
+	void ResetGrid();									// Clear mass, momentum, force and collisions of active tiles (*)
+
+	void AllocateBackBuffer();
+	void ClearBackTile(const int a);					// Clear tile ActiveTiles_back[a] (inside a parallel loop)
+	void SwapBuffers();									// Front (used) <-> back (cleared)
+	void DrawNodes();
+
+	// (*) Worksharing loops, called by all the threads of the step region (see Solver::Step)
+
+
+
+	/* Static Functions */
+	static int Wrap(const int x, const int n)			// Index in [0, n) (modulo only off the fast path)
+	{
+		if (x >= 0 && x < n)
+			return x;
+		int r = x % n;
+		return (r < 0) ? r + n : r;
+	}
+
+	static Vector2f Get(const NumaVector<double> V[2], const size_t i)
+	{
+		return Vector2f(V[0][i], V[1][i]);
+	}
+
+	static void Set(NumaVector<double> V[2], const size_t i, const Vector2f& inV)
+	{
+		V[0][i] = inV[0];
+		V[1][i] = inV[1];
+	}
+};
+
+
+
+/* Tile-blocked transfers: the nodes of a tile and of its stencil halo are copied in a small
+contiguous buffer (cache resident), one per thread. The particles binned in the tile are
+transferred against it, then P2G sums are added back to the grid (see Grid::FlushScratchpad). */
+
+struct Scratchpad
+{
+	static const int WIDTH = TILE + 3;					// Stencil bases of a tile, nodes base - 1 to base + 2
+	static const int SIZE = WIDTH * WIDTH;
+
+	int x0, y0;											// Grid node of scratchpad node 0 (not wrapped)
+	int nx, ny;											// Period of the grid axes (0 if not periodic)
+
+	double M[SIZE];
+	double V[2][SIZE];
+	double F[2][SIZE];
+
+	void Clear()
+	{
+		std::memset(M, 0, sizeof(M));
+		std::memset(V, 0, sizeof(V));
+		std::memset(F, 0, sizeof(F));
+	}
+
+	size_t Index(int x, int y) const					// Scratchpad index of stencil node (x, y)
+	{
+		// Bases binned across a periodic side (wrapped) are one period before the tile
+		x -= x0;
+		y -= y0;
+		if (x < 0)
+			x += nx;
+		if (y < 0)
+			y += ny;
+		return (size_t)y * WIDTH + x;
+	}
+
+	int Slot(int x, int y) const						// Scratchpad index of grid node (x, y), -1 if not covered
+	{
+		x -= x0;
+		y -= y0;
+		if (nx)
+			x += (x < 0) ? nx : (x >= WIDTH) ? -nx : 0;
+		if (ny)
+			y += (y < 0) ? ny : (y >= WIDTH) ? -ny : 0;
+		return (x < 0 || x >= WIDTH || y < 0 || y >= WIDTH) ? -1 : y * WIDTH + x;
+	}
+};
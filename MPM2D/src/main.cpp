@@ -4,22 +4,22 @@
 #include <GLFW/glfw3.h>
 
 #include "solver.h"
+#include "temporal.h"
 
 
 /* Declarations */
 void initGLContext();
 GLFWwindow* initGLFWContext();
 Solver* Simulation;
+TimeBlocks* Blocks = nullptr;							// Temporal blocking (TIME_BLOCK > 1)
 int t_count = 0;
+double insertion_time = 0.0;							// Next particle insertion (adaptive time-step)
 
-/* For video */
+/* For video (opened once the window size is known) */
 #if !WRITE_TO_FILE && RECORD_VIDEO
-std::string str_cmd = "ffmpeg -r " + std::to_string(FPS) + " -f rawvideo -pix_fmt rgba -s "
-+ std::to_string(X_WINDOW) + "x" + std::to_string(Y_WINDOW)
-+ " -i - -threads 0 -preset fast -y -pix_fmt yuv420p -crf 21 -vf vflip out/movie.mp4";
-const char* cmd = str_cmd.c_str();
-FILE* ffmpeg = _popen(cmd, "wb");
-int* buffer = new int[X_WINDOW * Y_WINDOW];
+FILE* ffmpeg;
+int* buffer;
+void initVideo();
 #endif
 
 
@@ -31,29 +31,91 @@ int* buffer = new int[X_WINDOW * Y_WINDOW];
 
 void Initialization()
 {
+	// Processes are started before any thread. Threads are pinned before the first touch of the
+	// node and particle arrays
+	Domain domain = Domain(StartTransport());
+	PinThreads(THREAD_AFFINITY, domain.rank, domain.ranks);
+
 	std::vector<Border> inBorders = Border::InitializeBorders();
-	std::vector<Node> inNodes = Node::InitializeNodes();
-	std::vector<Material> inParticles = Material::InitializeParticles();
+	std::vector<Collider> inColliders = Collider::InitializeColliders();
+	Grid inGrid = Grid(domain.g1 - domain.g0, Y_GRID, H, inBorders, 0, domain.g0);
+
+	// Particles are created by the first process and sent to the process of their slab
+	std::vector<Material> inParticles;
+	if (domain.rank == 0)
+		inParticles = Material::InitializeParticles();
+	domain.Scatter(inParticles);
+
+	Simulation = new Solver(inBorders, inColliders, inGrid, inParticles, domain);
+	if (TIME_BLOCK > 1)
+		Blocks = new TimeBlocks(*Simulation, TIME_BLOCK);
+}
+
+
+// Steps between two frames (fixed time-step)
+int FrameSteps()
+{
+	return std::max((int)(DT_render / DT), 1);
+}
+
+
+// Adaptive time-step: steps are cut to end on the frame times, the solver tells when one is reached
+bool FrameDue()
+{
+	if (ADAPTIVE_TIME_STEP)
+		return Simulation->on_stop;
+	return t_count % FrameSteps() == 0;
+}
+
+
+// Insertions every DT_ROB steps of the default time-step (in simulated time when it varies)
+bool InsertionDue()
+{
+	if (!ADAPTIVE_TIME_STEP)
+		return t_count % DT_ROB == 0;
+	if (Simulation->time < insertion_time)
+		return false;
+	insertion_time += DT_ROB * TIME_STEP;
+	return true;
+}
+
+
+// A block ends before the next particle insertion (done before a step) and with the next frame
+// (rendered after a step)
+int BlockLength()
+{
+	int frame = FrameSteps();
+	int next_frame = (t_count + frame - 1) / frame * frame;
+	int next_insertion = (t_count / DT_ROB + 1) * DT_ROB;
 
-	Simulation = new Solver(inBorders, inNodes, inParticles);
+	return std::min(TIME_BLOCK, std::min(next_frame - t_count + 1, next_insertion - t_count));
 }
 
 
 void Update()
 {
-	Simulation->P2G();									// Transfer data from Particles to Grid Nodes
-	Simulation->UpdateNodes();							// Update nodes data
-	Simulation->G2P();									// Transfer data from Grid Nodes to Particles
-	Simulation->UpdateParticles();						// Update particles data
+	if (!Blocks)
+	{
+		Simulation->Step();								// Reset grid, P2G, update nodes, G2P, update particles
+		return;
+	}
+
+	// Several steps at once: t_count is left on the last step of the block
+	int steps = BlockLength();
+	Blocks->Advance(*Simulation, steps);
+	t_count += steps - 1;
 }
 
 
 void AddParticles()										// Add particle during the simulation
 {							
 	// DT_ROB gives the rate of insertion. Maximum number of particles
-	if (t_count % DT_ROB == 0 && Simulation->particles.size() < 3000)
+	if (InsertionDue() && Simulation->domain.Sum((double)Simulation->particles.size()) < 3000)
 	{
-		std::vector<Material> new_p = Material::AddParticles();
+		std::vector<Material> new_p;
+		if (Simulation->domain.rank == 0)
+			new_p = Material::AddParticles();
+		Simulation->domain.Scatter(new_p);
 		for (size_t p = 0, plen = new_p.size(); p < plen; p++)
 			Simulation->particles.push_back(new_p[p]);
 	}
@@ -69,6 +131,7 @@ void AddParticles()										// Add particle during the simulation
 int main(int argc, char** argv)
 {
 	/* Initialize Simulation */
+	ReadParameters(argc, argv);
 	Initialization();
 
 	/* [1] : output data to .ply file (to read in Houdini for example) */
@@ -78,23 +141,30 @@ int main(int argc, char** argv)
 	{
 		AddParticles();
 		Update();
-		if (t_count % (int)(DT_render / DT) == 0)		// Record frame at desired rate
+		if (FrameDue())									// Record frame at desired rate
 			Simulation->WriteToFile(frame_count++);
-		Simulation->ResetGrid();
 		t_count++;
 	}
 	
 	#else
 	/* [2] : show result on OpenGL window, and record an .mp4 if selected */
+	if (Simulation->domain.ranks > 1)
+	{
+		std::cerr << "Multi-process runs write their slabs to files (WRITE_TO_FILE)" << std::endl;
+		exit(EXIT_FAILURE);
+	}
 	GLFWwindow* window = initGLFWContext();				
 	initGLContext();
+	#if RECORD_VIDEO
+	initVideo();
+	#endif
 	while (!glfwWindowShouldClose(window))
 	{
 		glClear(GL_COLOR_BUFFER_BIT);
 
 		AddParticles();
 		Update();
-		if (t_count % (int)(DT_render / DT) == 0)		// Display frame at desired rate
+		if (FrameDue())									// Display frame at desired rate
 		{
 			Simulation->Draw();
 			glfwSwapBuffers(window);
@@ -104,7 +174,6 @@ int main(int argc, char** argv)
 			#endif
 			glfwPollEvents();
 		}
-		Simulation->ResetGrid();
 		t_count++;
 	}
 
@@ -151,9 +220,22 @@ void initGLContext()
 	glLoadIdentity();
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
-	glOrtho(0, X_GRID, 0, Y_GRID, -1, 1);					// original
+	glOrtho(0, X_DOMAIN, 0, Y_DOMAIN, -1, 1);				// original
 	glViewport(0, 0, (GLsizei)X_WINDOW, (GLsizei)Y_WINDOW);	// transfo
 
 	glClearColor(.4f, .4f, .4f, .0f);
 	glClear(GL_COLOR_BUFFER_BIT);
-}
\ No newline at end of file
+}
+
+
+#if !WRITE_TO_FILE && RECORD_VIDEO
+/* Pipe frames to ffmpeg */
+void initVideo()
+{
+	std::string str_cmd = "ffmpeg -r " + std::to_string(FPS) + " -f rawvideo -pix_fmt rgba -s "
+		+ std::to_string(X_WINDOW) + "x" + std::to_string(Y_WINDOW)
+		+ " -i - -threads 0 -preset fast -y -pix_fmt yuv420p -crf 21 -vf vflip out/movie.mp4";
+	ffmpeg = _popen(str_cmd.c_str(), "wb");
+	buffer = new int[X_WINDOW * Y_WINDOW];
+}
+#endif
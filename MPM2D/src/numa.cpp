@@ -0,0 +1,110 @@
+#include "numa.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <omp.h>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+
+
+/* -----------------------------------------------------------------------
+|								FIRST TOUCH								 |
+----------------------------------------------------------------------- */
+
+
+// Small arrays fit in a few pages, and inside a parallel region the calling thread places them
+void TouchPages(void* p, const size_t bytes)
+{
+	if (bytes < FIRST_TOUCH_MIN || omp_in_parallel())
+		return;
+
+	char* c = static_cast<char*>(p);
+
+	#pragma omp parallel
+	{
+		size_t threads = omp_get_num_threads(), t = omp_get_thread_num();
+		size_t b0 = bytes * t / threads, b1 = bytes * (t + 1) / threads;
+		memset(c + b0, 0, b1 - b0);
+	}
+}
+
+
+
+/* -----------------------------------------------------------------------
+|							THREAD AFFINITY								 |
+----------------------------------------------------------------------- */
+
+
+// CPUs the process may run on, in system order (cores of a socket are numbered together)
+static std::vector<int> AllowedCpus()
+{
+	std::vector<int> cpus;
+
+	#if defined(_WIN32)
+	DWORD_PTR process, system;
+	if (GetProcessAffinityMask(GetCurrentProcess(), &process, &system))
+		for (int c = 0; c < (int)(8 * sizeof(DWORD_PTR)); c++)
+			if ((process >> c) & 1)
+				cpus.push_back(c);
+	#elif defined(__linux__)
+	cpu_set_t set;
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+		for (int c = 0; c < CPU_SETSIZE; c++)
+			if (CPU_ISSET(c, &set))
+				cpus.push_back(c);
+	#endif
+
+	return cpus;
+}
+
+
+static bool PinThread(const int cpu)
+{
+	#if defined(_WIN32)
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+	#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+	#else
+	return false;
+	#endif
+}
+
+
+// Compact: thread t on CPU t (fills a socket first). Spread: threads evenly over the CPUs (all
+// sockets, their memory bandwidth). OpenMP keeps its threads between the parallel regions. The
+// processes of a run on one machine share the CPUs: threads are numbered across the processes
+void PinThreads(const int mode, const int process, const int processes)
+{
+	if (mode == 0)
+		return;
+
+	const std::vector<int> cpus = AllowedCpus();
+	if (cpus.empty())
+	{
+		std::cerr << "Thread affinity is not supported on this system" << std::endl;
+		return;
+	}
+
+	bool pinned = true;
+
+	#pragma omp parallel reduction (&& : pinned)
+	{
+		size_t threads = omp_get_num_threads() * (size_t)processes, n = cpus.size();
+		size_t t = omp_get_num_threads() * (size_t)process + omp_get_thread_num();
+		size_t k = (mode == 1) ? t % n : (t * n / threads) % n;
+		pinned = PinThread(cpus[k]);
+	}
+
+	if (!pinned)
+		std::cerr << "Some threads could not be pinned" << std::endl;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "constants.h"
+
+/* NUMA placement. A memory page is placed on the socket of the thread that writes it first,
+so arrays filled by the main thread end up entirely on its socket. FirstTouch allocates the
+large arrays (grid nodes, particles) and writes their pages in parallel right away, with the
+static split of the particle loops (thread t: elements [t n / T, (t + 1) n / T)): each socket
+then streams its own share from local memory. Threads have to stay on their cores for this to
+hold (PinThreads, before the allocations). */
+
+void TouchPages(void* p, const size_t bytes);				// Parallel first touch (outside parallel regions)
+void PinThreads(const int mode,								// [0] OS - [1] Compact - [2] Spread
+	const int process = 0, const int processes = 1);		// (threads of all the processes)
+
+
+template <class T>
+struct FirstTouch
+{
+	typedef T value_type;
+
+	FirstTouch() {}
+	template <class U>
+	FirstTouch(const FirstTouch<U>&) {}
+
+	T* allocate(const size_t n)
+	{
+		T* p = std::allocator<T>().allocate(n);
+		TouchPages(p, n * sizeof(T));
+		return p;
+	}
+
+	void deallocate(T* p, const size_t n)
+	{
+		std::allocator<T>().deallocate(p, n);
+	}
+};
+
+template <class T, class U>
+bool operator==(const FirstTouch<T>&, const FirstTouch<U>&) { return true; }
+template <class T, class U>
+bool operator!=(const FirstTouch<T>&, const FirstTouch<U>&) { return false; }
+
+
+template <class T>
+using NumaVector = std::vector<T, FirstTouch<T>>;			// Vector placed by parallel first touch
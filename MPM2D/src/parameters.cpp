@@ -0,0 +1,178 @@
+#include "parameters.h"
+#include "simd.h"
+
+/* Default values */
+double X_DOMAIN = X_SIZE;
+double Y_DOMAIN = Y_SIZE;
+double H = CELL_SIZE;
+double H_INV = 1.0 / CELL_SIZE;
+int X_GRID = 0;
+int Y_GRID = 0;
+bool ADAPTIVE_GRID = ADAPTIVE;
+bool PERIODIC_X = PERIODIC[0];
+bool PERIODIC_Y = PERIODIC[1];
+bool DOUBLE_BUFFER_GRID = DOUBLE_BUFFER;
+bool MOVING_COLLIDERS = COLLIDERS;
+int INTERPOLATION_MODE = INTERPOLATION;
+double CUB = Spline<INTERPOLATION>::CUB;
+int P2G_MODE = P2G_TYPE;
+bool SIMD_KERNELS = SIMD;
+bool TASK_GRAPH = TASKS;
+bool LOAD_BALANCE = BALANCE;
+bool DETERMINISTIC_SUMS = DETERMINISTIC;
+double DT = TIME_STEP;
+bool ADAPTIVE_TIME_STEP = ADAPTIVE_DT;
+int THREAD_AFFINITY = AFFINITY;
+int PROCESSES = RANKS;
+int TIME_BLOCK = BLOCK_STEPS;
+
+int Y_WINDOW = 0;
+
+
+
+void ReadParameters(int argc, char** argv)
+{
+	for (int a = 1; a < argc; a += 2)
+	{
+		std::string option = argv[a];
+		if (a + 1 >= argc)
+		{
+			std::cerr << "Missing value for option " << option << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		double value = atof(argv[a + 1]);
+
+		if (option == "-x")
+			X_DOMAIN = value;
+		else if (option == "-y")
+			Y_DOMAIN = value;
+		else if (option == "-h")
+			H = value;
+		else if (option == "-adaptive")
+			ADAPTIVE_GRID = (value != 0);
+		else if (option == "-periodic_x")
+			PERIODIC_X = (value != 0);
+		else if (option == "-periodic_y")
+			PERIODIC_Y = (value != 0);
+		else if (option == "-double_buffer")
+			DOUBLE_BUFFER_GRID = (value != 0);
+		else if (option == "-colliders")
+			MOVING_COLLIDERS = (value != 0);
+		else if (option == "-interpolation")
+			INTERPOLATION_MODE = static_cast<int>(value);
+		else if (option == "-p2g")
+			P2G_MODE = static_cast<int>(value);
+		else if (option == "-simd")
+			SIMD_KERNELS = (value != 0);
+		else if (option == "-tasks")
+			TASK_GRAPH = (value != 0);
+		else if (option == "-balance")
+			LOAD_BALANCE = (value != 0);
+		else if (option == "-deterministic")
+			DETERMINISTIC_SUMS = (value != 0);
+		else if (option == "-dt")
+			DT = value;
+		else if (option == "-adaptive_dt")
+			ADAPTIVE_TIME_STEP = (value != 0);
+		else if (option == "-affinity")
+			THREAD_AFFINITY = static_cast<int>(value);
+		else if (option == "-ranks")
+			PROCESSES = static_cast<int>(value);
+		else if (option == "-time_block")
+			TIME_BLOCK = static_cast<int>(value);
+		else
+		{
+			std::cerr << "Unknown option " << option << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (INTERPOLATION_MODE != 1 && INTERPOLATION_MODE != 2)
+	{
+		std::cerr << "Unknown interpolation type " << INTERPOLATION_MODE << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	CUB = (INTERPOLATION_MODE == 1) ? Spline<1>::CUB : Spline<2>::CUB;
+
+	if (H <= 0 || X_DOMAIN <= 2 * CUB * H || Y_DOMAIN <= 2 * CUB * H)
+	{
+		std::cerr << "Invalid grid: " << X_DOMAIN << " x " << Y_DOMAIN << ", h = " << H << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	if (ADAPTIVE_GRID && INTERPOLATION_MODE != 1)
+	{
+		std::cerr << "The adaptive grid requires cubic interpolation" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	if (P2G_MODE < 0 || P2G_MODE > 4)
+	{
+		std::cerr << "Unknown P2G type " << P2G_MODE << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Tasks are built on the tile bins of the tiled P2G, on a single level
+	if (TASK_GRAPH && ADAPTIVE_GRID)
+	{
+		std::cerr << "The task scheduler does not support the adaptive grid" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (TASK_GRAPH)
+		P2G_MODE = 4;
+
+	// Atomic adds and thread-private grids sum in an order that depends on the threads: tiled sums
+	// instead (colored and gather P2G already sum in a fixed order)
+	if (DETERMINISTIC_SUMS && (P2G_MODE == 0 || P2G_MODE == 2))
+		P2G_MODE = 4;
+
+	if (THREAD_AFFINITY < 0 || THREAD_AFFINITY > 2)
+	{
+		std::cerr << "Unknown thread affinity " << THREAD_AFFINITY << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	if (PROCESSES < 1)
+	{
+		std::cerr << "Invalid number of processes " << PROCESSES << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	if (DT <= 0)
+	{
+		std::cerr << "Invalid time-step " << DT << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Strips of temporal blocking cover the whole height and cannot wrap around in x
+	if (TIME_BLOCK < 1)
+	{
+		std::cerr << "Invalid number of steps per block " << TIME_BLOCK << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (TIME_BLOCK > 1 && (ADAPTIVE_GRID || PERIODIC_X || TASK_GRAPH || ADAPTIVE_TIME_STEP))
+	{
+		std::cerr << "Temporal blocking does not support the adaptive grid, periodic x, the task graph"
+			<< " or adaptive time-steps" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Scalar loops on CPUs without AVX2
+	SIMD_KERNELS = SIMD_KERNELS && SimdSupported();
+
+	// The coarse level is padded, it cannot wrap around
+	if (ADAPTIVE_GRID && (PERIODIC_X || PERIODIC_Y))
+	{
+		std::cerr << "Periodic domains are not supported with the adaptive grid" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Whole number of cells: the domain is rounded up to a multiple of h
+	H_INV = 1.0 / H;
+	X_GRID = static_cast<int>(ceil(X_DOMAIN * H_INV - 1e-9));
+	Y_GRID = static_cast<int>(ceil(Y_DOMAIN * H_INV - 1e-9));
+	X_DOMAIN = X_GRID * H;
+	Y_DOMAIN = Y_GRID * H;
+
+	Y_WINDOW = static_cast<int>(X_WINDOW * Y_DOMAIN / X_DOMAIN);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "constants.h"
+#include "spline.h"
+
+/* Runtime parameters. Default values are the options of constants.h,
+they can be overridden on the command line with "-option value" pairs:
+	-x <size>	Domain width (physical units)
+	-y <size>	Domain height (physical units)
+	-h <size>	Grid cell size
+	-adaptive <0|1>	Two-level adaptive grid
+	-periodic_x <0|1>, -periodic_y <0|1>	Periodic domain
+	-double_buffer <0|1>	Double-buffered grid
+	-colliders <0|1>	Moving kinematic colliders
+	-p2g <0|1|2|3|4>	P2G: atomic adds, colored particle blocks, thread-private grids, gather by node
+		or tiles with scratchpads (also used by G2P)
+	-interpolation <1|2>	Cubic or quadratic B-splines
+	-simd <0|1>	Vectorized transfer kernels (AVX2, detected at runtime)
+	-tasks <0|1>	Step as a task graph over tiles, with work stealing (tiled P2G, single level grid)
+	-balance <0|1>	Particle update split among threads by measured cost
+	-deterministic <0|1>	Node sums in a fixed order (tiled P2G unless colored or gather): same results for any thread count
+	-dt <step>	Time-step (fixed)
+	-adaptive_dt <0|1>	Time-step chosen each step from the particle speeds and the elastic wave speeds
+	-affinity <0|1|2>	Threads placed by the OS, pinned compact (socket by socket) or spread
+	-time_block <k>	Steps advanced at once by strips of the domain, with redundant halos (temporal blocking)
+	-ranks <n>	Processes on this machine, one slab of the domain each (MPI builds: set by mpirun) */
+
+
+/* ----- GRID ----- */
+extern double X_DOMAIN;									// Size of the domain (physical units)
+extern double Y_DOMAIN;
+extern double H;										// Cell size
+extern double H_INV;
+extern int X_GRID;										// Number of cells
+extern int Y_GRID;
+extern bool ADAPTIVE_GRID;								// Refined patches on a coarse grid (see refinement.h)
+extern bool PERIODIC_X;									// Periodic sides: stencils and particles wrap around
+extern bool PERIODIC_Y;
+extern bool DOUBLE_BUFFER_GRID;							// Grid reset done during the particle update
+extern bool MOVING_COLLIDERS;							// Scene with kinematic colliders
+
+
+/* ----- TRANSFER ----- */
+extern int INTERPOLATION_MODE;							// [1] Cubic - [2] Quadratic (see spline.h)
+extern double CUB;										// Range of the interpolation function (cells)
+extern int P2G_MODE;									// P2G: [0] Atomic - [1] Colored blocks - [2] Thread-private grids - [3] Gather - [4] Tiled
+extern bool SIMD_KERNELS;								// Vectorized kernels requested and supported by the CPU
+extern bool TASK_GRAPH;									// Step run as a task graph (see Solver::TaskStep)
+extern bool LOAD_BALANCE;								// Cost-driven particle ranges (see partitioner.h)
+extern bool DETERMINISTIC_SUMS;							// Fixed summation order of the nodes (see Grid::SumScratchpads)
+extern double DT;										// Time-step of the current step
+extern bool ADAPTIVE_TIME_STEP;							// CFL-bounded time-step (see Solver::ChooseTimeStep)
+extern int THREAD_AFFINITY;								// [0] OS - [1] Compact - [2] Spread (see numa.h)
+extern int TIME_BLOCK;									// Steps per temporal block (see temporal.h)
+extern int PROCESSES;									// Processes (slabs in x) started by the socket transport
+
+
+/* ----- RENDERING ----- */
+extern int Y_WINDOW;									// Window height (X_WINDOW is fixed)
+
+
+
+/* Read the command line options and derive the dependent parameters */
+void ReadParameters(int argc, char** argv);
@@ -150,6 +150,13 @@ void Water::UpdateDeformation(const Matrix2f& T)
 }
 
 
+// Sound speed of the equation of state: bulk modulus -J dp/dJ = GAMMA K J^-GAMMA, density Mp / (Vp0 J)
+double Water::WaveSpeed() const
+{
+	return sqrt(GAMMA_water * K_water * pow(Jp, 1 - GAMMA_water) * Vp0 / Mp);
+}
+
+
 // Dry Sand: http://www.math.ucla.edu/~jteran/papers/KGPSJT16.pdf 
 void DrySand::ConstitutiveModel()
 {
@@ -172,6 +179,13 @@ void DrySand::UpdateDeformation(const Matrix2f& T)
 }
 
 
+// Pressure wave speed sqrt((lambda + 2 mu) / rho), at the current density Mp / (Vp0 J)
+double DrySand::WaveSpeed() const
+{
+	return sqrt((LAMBDA_dry_sand + 2 * MU_dry_sand) * fabs(Fe.det() * Fp.det()) * Vp0 / Mp);
+}
+
+
 void DrySand::Plasticity()
 {
 	Matrix2f U, V;
@@ -243,6 +257,13 @@ void Snow::UpdateDeformation(const Matrix2f& T)
 }
 
 
+// Lame parameters hardened by the plastic compression (see Plasticity)
+double Snow::WaveSpeed() const
+{
+	return sqrt((lam + 2 * mu) * fabs(Je * Jp) * Vp0 / Mp);
+}
+
+
 void Snow::Plasticity()
 {
 	Matrix2f U, V;
@@ -281,6 +302,153 @@ void Elastic::UpdateDeformation(const Matrix2f& T)
 }
 
 
+double Elastic::WaveSpeed() const
+{
+	return sqrt((lam + 2 * mu) * fabs(Fe.det()) * Vp0 / Mp);
+}
+
+
+
+/* -----------------------------------------------------------------------
+|							PROCESS TRANSFERS							 |
+----------------------------------------------------------------------- */
+
+
+// Vectors and matrices have virtual destructors: particles are not plain data, their values are
+// sent as doubles and read back into constructed particles (default constructors: no random
+// colors drawn, see Domain)
+void Particle::Pack(std::vector<double>& out) const
+{
+	out.push_back(Vp0);
+	out.push_back(Mp);
+	out.push_back(Xp[0]); out.push_back(Xp[1]);
+	out.push_back(Vp[0]); out.push_back(Vp[1]);
+	PackMatrix(out, Bp);
+}
+
+
+void Particle::Unpack(const double*& in)
+{
+	Vp0 = in[0];
+	Mp = in[1];
+	Xp = Vector2f(in[2], in[3]);
+	Vp = Vector2f(in[4], in[5]);
+	in += 6;
+	Bp = UnpackMatrix(in);
+}
+
+
+void Particle::PackMatrix(std::vector<double>& out, const Matrix2f& M)
+{
+	out.push_back(M[0][0]); out.push_back(M[0][1]);
+	out.push_back(M[1][0]); out.push_back(M[1][1]);
+}
+
+
+Matrix2f Particle::UnpackMatrix(const double*& in)
+{
+	Matrix2f M = Matrix2f(in[0], in[1], in[2], in[3]);
+	in += 4;
+	return M;
+}
+
+
+void Water::Pack(std::vector<double>& out) const
+{
+	Particle::Pack(out);
+	out.push_back(Ap);
+	out.push_back(Jp);
+}
+
+
+Water Water::Unpack(const double*& in)
+{
+	Water p;
+	p.Particle::Unpack(in);
+	p.Ap = in[0];
+	p.Jp = in[1];
+	in += 2;
+	return p;
+}
+
+
+void DrySand::Pack(std::vector<double>& out) const
+{
+	Particle::Pack(out);
+	PackMatrix(out, Ap);
+	PackMatrix(out, Fe); PackMatrix(out, FeTr);
+	PackMatrix(out, Fp); PackMatrix(out, FpTr);
+	out.push_back(q);
+	out.push_back(alpha);
+	out.push_back(r);
+}
+
+
+DrySand DrySand::Unpack(const double*& in)
+{
+	DrySand p;
+	p.Particle::Unpack(in);
+	p.Ap = UnpackMatrix(in);
+	p.Fe = UnpackMatrix(in); p.FeTr = UnpackMatrix(in);
+	p.Fp = UnpackMatrix(in); p.FpTr = UnpackMatrix(in);
+	p.q = in[0];
+	p.alpha = in[1];
+	p.r = in[2];
+	in += 3;
+	return p;
+}
+
+
+void Snow::Pack(std::vector<double>& out) const
+{
+	Particle::Pack(out);
+	PackMatrix(out, Ap);
+	PackMatrix(out, Fe); PackMatrix(out, FeTr);
+	PackMatrix(out, Fp); PackMatrix(out, FpTr);
+	out.push_back(Je); out.push_back(Jp);
+	out.push_back(lam); out.push_back(mu);
+	out.push_back(s); out.push_back(r);
+}
+
+
+Snow Snow::Unpack(const double*& in)
+{
+	Snow p;
+	p.Particle::Unpack(in);
+	p.Ap = UnpackMatrix(in);
+	p.Fe = UnpackMatrix(in); p.FeTr = UnpackMatrix(in);
+	p.Fp = UnpackMatrix(in); p.FpTr = UnpackMatrix(in);
+	p.Je = in[0]; p.Jp = in[1];
+	p.lam = in[2]; p.mu = in[3];
+	p.s = in[4]; p.r = in[5];
+	in += 6;
+	return p;
+}
+
+
+void Elastic::Pack(std::vector<double>& out) const
+{
+	Particle::Pack(out);
+	PackMatrix(out, Ap);
+	PackMatrix(out, Fe);
+	out.push_back(lam); out.push_back(mu);
+	out.push_back(r); out.push_back(g); out.push_back(b);
+}
+
+
+Elastic Elastic::Unpack(const double*& in)
+{
+	Elastic p;
+	p.Particle::Unpack(in);
+	p.Ap = UnpackMatrix(in);
+	p.Fe = UnpackMatrix(in);
+	p.lam = in[0]; p.mu = in[1];
+	p.r = in[2]; p.g = in[3]; p.b = in[4];
+	in += 5;
+	return p;
+}
+
+
 
 /* -----------------------------------------------------------------------
 |								RENDERING								 |
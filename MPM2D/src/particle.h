@@ -6,7 +6,7 @@
 #include <GLFW/glfw3.h>
 #include <PoissonGenerator/PoissonGenerator.h>
 
-#include "constants.h"
+#include "parameters.h"
 
 /* The particle class contains data commun to all simulation.
 The material subclasses contains particular data and methods. */
@@ -30,6 +30,18 @@ public:
 	Particle(const double inVp0, const double inMp,
 		const Vector2f& inXp, const Vector2f& inVp, const Matrix2f& inBp);
 	~Particle() {};
+
+
+
+	/* Functions */
+	void Pack(std::vector<double>& out) const;				// Append the data to a buffer (sent to another process)
+	void Unpack(const double*& in);							// Data read from a buffer (in is advanced)
+
+
+
+	/* Static Functions */
+	static void PackMatrix(std::vector<double>& out, const Matrix2f& M);
+	static Matrix2f UnpackMatrix(const double*& in);
 };
 
 
@@ -67,12 +79,16 @@ public:
 	/* Functions */
 	void ConstitutiveModel();								// Deformation gradient increment
 	void UpdateDeformation(const Matrix2f& T);				// Deformation gradient update
+	double WaveSpeed() const;								// Speed of the elastic waves (adaptive time-step)
+	void Pack(std::vector<double>& out) const;				// Particle data and state (sent to another process)
 
 	void DrawParticle();
 
 
 
 	/* Static Functions */
+	static Water Unpack(const double*& in);					// Particle read from a buffer (in is advanced)
+
 	static std::vector<Water> InitializeParticles()
 	{
 		std::vector<Water> outParticles;
@@ -89,7 +105,7 @@ public:
 		{
 			double r = ((double)rand() / (RAND_MAX));			// random number
 
-			Vector2f pos = Vector2f((double)CUB, (double)(Y_GRID - 2 * CUB - 0.5*p - r));		// new positions
+			Vector2f pos = Vector2f(CUB * H, Y_DOMAIN - 2 * CUB * H - 0.5*p - r);		// new positions
 			outParticles.push_back(Particle(1.14, 0.0005, pos, v, a));	
 		}
 
@@ -128,6 +144,8 @@ public:
 	/* Functions */
 	void ConstitutiveModel();								// Deformation gradient increment
 	void UpdateDeformation(const Matrix2f& T);				// Deformation gradient update
+	double WaveSpeed() const;								// Speed of the elastic waves (adaptive time-step)
+	void Pack(std::vector<double>& out) const;				// Particle data and state (sent to another process)
 	void Plasticity();										// Update plastic dissipation
 	void Projection											// Return mapping algorithm
 	(const Vector2f& Eps, Vector2f* T, double* dq);
@@ -137,6 +155,8 @@ public:
 
 
 	/* Static Functions */
+	static DrySand Unpack(const double*& in);				// Particle read from a buffer (in is advanced)
+
 	static std::vector<DrySand> InitializeParticles()
 	{
 		std::vector<DrySand> outParticles;
@@ -145,10 +165,10 @@ public:
 		std::vector<sPoint> P_c = GeneratePoissonPoints(2000, PRNG);
 		int NP = static_cast <int>(P_c.size());
 
-		double W_COL = X_GRID / 8.0;
-		double H_COL = (Y_GRID - 2 * CUB) * 0.9;
-		double X_COL = (X_GRID - W_COL) / 2.0;
-		double Y_COL = CUB;
+		double W_COL = X_DOMAIN / 8.0;
+		double H_COL = (Y_DOMAIN - 2 * CUB * H) * 0.9;
+		double X_COL = (X_DOMAIN - W_COL) / 2.0;
+		double Y_COL = CUB * H;
 
 		double VOL = W_COL * H_COL / static_cast<double>(NP);
 		double MASS = VOL * RHO_dry_sand / 100.0;
@@ -206,6 +226,8 @@ public:
 	/* Functions */
 	void ConstitutiveModel();								// Deformation gradient increment
 	void UpdateDeformation(const Matrix2f& T);				// Deformation gradient update
+	double WaveSpeed() const;								// Speed of the elastic waves (adaptive time-step)
+	void Pack(std::vector<double>& out) const;				// Particle data and state (sent to another process)
 	void Plasticity();										// Update plastic dissipation
 
 	void DrawParticle();
@@ -213,6 +235,8 @@ public:
 
 
 	/* Static Functions */
+	static Snow Unpack(const double*& in);					// Particle read from a buffer (in is advanced)
+
 	static std::vector<Snow> InitializeParticles()
 	{
 		std::vector<Snow> outParticles;
@@ -221,9 +245,9 @@ public:
 		std::vector<sPoint> P_c = GeneratePoissonPoints(3000, PRNG, 30, true);
 		int NP = static_cast <int>(P_c.size());
 
-		double R_BALL = fmin(double(X_GRID), double(Y_GRID)) * 0.33;
-		double X_BALL = X_GRID * 0.3;
-		double Y_BALL = Y_GRID * 0.45;
+		double R_BALL = fmin(X_DOMAIN, Y_DOMAIN) * 0.33;
+		double X_BALL = X_DOMAIN * 0.3;
+		double Y_BALL = Y_DOMAIN * 0.45;
 
 		double VOL = 2 * PI*R_BALL*R_BALL / static_cast<double>(NP);
 		double MASS = VOL * RHO_snow / 100.0;
@@ -233,12 +257,12 @@ public:
 
 		for (int p = 0; p < NP; p++)
 		{
-			Vector2f pos = Vector2f(P_c[p].x * R_BALL + X_BALL, P_c[p].y * R_BALL + Y_GRID - Y_BALL);
+			Vector2f pos = Vector2f(P_c[p].x * R_BALL + X_BALL, P_c[p].y * R_BALL + Y_DOMAIN - Y_BALL);
 			outParticles.push_back(Snow(VOL, MASS, pos, v, a));
 		}
 		for (int p = 0; p < NP; p++)
 		{
-			Vector2f pos = Vector2f(P_c[p].x * R_BALL + X_GRID - X_BALL, P_c[p].y * R_BALL + Y_BALL);
+			Vector2f pos = Vector2f(P_c[p].x * R_BALL + X_DOMAIN - X_BALL, P_c[p].y * R_BALL + Y_BALL);
 			outParticles.push_back(Snow(VOL, MASS, pos, -v, a));
 		}
 
@@ -281,22 +305,26 @@ public:
 	/* Functions */
 	void ConstitutiveModel();								// Deformation gradient increment
 	void UpdateDeformation(const Matrix2f& T);				// Deformation gradient update
+	double WaveSpeed() const;								// Speed of the elastic waves (adaptive time-step)
+	void Pack(std::vector<double>& out) const;				// Particle data and state (sent to another process)
 
 	void DrawParticle();
 
 
 
 	/* Static Functions */
+	static Elastic Unpack(const double*& in);				// Particle read from a buffer (in is advanced)
+
 	static std::vector<Elastic> InitializeParticles()
 	{
 		std::vector<Elastic> outParticles;
 
 		std::vector<Vector2f> positions;					// Create cube point cloud
-		for (double i = 0; i < fmax(X_GRID, Y_GRID) / 8.0; i ++)
-			for (double j = 0; j < fmax(X_GRID, Y_GRID) / 8.0; j ++)
+		for (double i = 0; i < fmax(X_DOMAIN, Y_DOMAIN) / 8.0; i ++)
+			for (double j = 0; j < fmax(X_DOMAIN, Y_DOMAIN) / 8.0; j ++)
 				positions.push_back(Vector2f(i, j));
 
-		double VOL = (double)fmax(X_GRID, Y_GRID) * (double)fmax(X_GRID, Y_GRID) / 16.0;
+		double VOL = fmax(X_DOMAIN, Y_DOMAIN) * fmax(X_DOMAIN, Y_DOMAIN) / 16.0;
 		double MASS = VOL * RHO_elastic / 100.0;
 
 		Vector2f v = Vector2f(30, 0);							// Initial velocity
@@ -304,17 +332,17 @@ public:
 
 		for (size_t p = 0, plen = positions.size(); p < plen; p++)
 		{														// 1st cube
-			Vector2f pos = Vector2f(positions[p][0] + X_GRID * 0.1, positions[p][1] + Y_GRID / 3.0);
+			Vector2f pos = Vector2f(positions[p][0] + X_DOMAIN * 0.1, positions[p][1] + Y_DOMAIN / 3.0);
 			outParticles.push_back(Elastic(VOL, MASS, pos, v, a, LAM_elastic*0.1, MU_elastic*0.1, 1, 0, 0));
 		}
 		for (size_t p = 0, plen = positions.size(); p < plen; p++)
 		{														// 2nd cube
-			Vector2f pos = Vector2f(positions[p][0] + X_GRID * 0.325, positions[p][1] + Y_GRID / 2.0);
+			Vector2f pos = Vector2f(positions[p][0] + X_DOMAIN * 0.325, positions[p][1] + Y_DOMAIN / 2.0);
 			outParticles.push_back(Elastic(VOL, MASS, pos, v, a, LAM_elastic, MU_elastic, 0, 0, 1));
 		}
 		for (size_t p = 0, plen = positions.size(); p < plen; p++)
 		{														// 3rd cube
-			Vector2f pos = Vector2f(positions[p][0] + X_GRID * 0.55, positions[p][1] + Y_GRID * 2 / 3.0);
+			Vector2f pos = Vector2f(positions[p][0] + X_DOMAIN * 0.55, positions[p][1] + Y_DOMAIN * 2 / 3.0);
 			outParticles.push_back(Elastic(VOL, MASS, pos, v, a, 100*LAM_elastic, 100*MU_elastic, 0, 1, 0));
 		}
 
@@ -328,3 +356,25 @@ public:
 		return outParticles;
 	}
 };
+
+
+/* ---------------------------------------------------------------------------------------------- */
+
+
+
+/* MATERIAL TRAITS */
+// Arithmetic each material needs in the transfers: the solver kernels are specialized on them.
+// The P2G force follows the type of Ap: a double Ap is a pressure (force Ap * dWip, as Water)
+template <class M>
+struct MaterialTraits
+{
+	static constexpr bool TRACE_ONLY = false;					// UpdateDeformation only reads the trace of T
+	static constexpr bool FRICTION = true;						// Frictions at the borders and colliders
+};
+
+template <>
+struct MaterialTraits<Water>
+{
+	static constexpr bool TRACE_ONLY = true;
+	static constexpr bool FRICTION = false;
+};
@@ -0,0 +1,32 @@
+#include "partitioner.h"
+
+// Blocks of particles added since the last step take the mean cost (no measure yet),
+// every block has the same cost at the first step
+void Partitioner::Balance(const int plen, const int threads)
+{
+	const int blocks = (plen + PARTITION_BLOCK - 1) / PARTITION_BLOCK;
+
+	double total = 0.0;
+	for (size_t b = 0; b < BlockCost.size(); b++)
+		total += BlockCost[b];
+	double mean = BlockCost.empty() ? 1.0 : total / BlockCost.size();
+	if (mean <= 0.0)
+		mean = 1.0;
+	BlockCost.resize(blocks, mean);
+
+	total = 0.0;
+	for (int b = 0; b < blocks; b++)
+		total += BlockCost[b];
+
+	// Thread t starts at the first block where the cost before it reaches t / threads of the total
+	Start.assign(threads + 1, blocks);
+	Start[0] = 0;
+	double sum = 0.0;
+	int t = 1;
+	for (int b = 0; b < blocks && t < threads; b++)
+	{
+		while (t < threads && sum >= total * t / threads)
+			Start[t++] = b;
+		sum += BlockCost[b];
+	}
+}
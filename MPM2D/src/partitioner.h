@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "constants.h"
+
+/* Cost-driven partition of the particle update. Particles are grouped in blocks of
+PARTITION_BLOCK (in index order), the time spent on each block is measured and smoothed over
+the steps. Each thread gets a contiguous range of blocks of the same total cost: in clustered
+scenes the particles on the yield surface (return mapping) are much more expensive than the
+elastic ones, equal particle counts do not give equal work. Smoothing makes the ranges move
+gradually from step to step instead of following the timer noise. */
+
+class Partitioner
+{
+public:
+
+	/* Data */
+	std::vector<double> BlockCost;							// Smoothed cost (s) of each block
+	std::vector<int> Start;									// First block of each thread (threads + 1)
+
+
+
+	/* Constructors */
+	Partitioner() {};
+	~Partitioner() {};
+
+
+
+	/* Functions */
+	void Balance(const int plen, const int threads);		// Ranges of equal cost (one thread)
+	void Range(const int thread, const int plen,			// Particle range [p0, p1) of a thread
+		int& p0, int& p1) const
+	{
+		p0 = Start[thread] * PARTITION_BLOCK;
+		p1 = std::min(Start[thread + 1] * PARTITION_BLOCK, plen);
+	}
+	void Record(const int block, const double cost)		// Measured cost of a block this step
+	{
+		BlockCost[block] = PARTITION_SMOOTHING * BlockCost[block] + (1.0 - PARTITION_SMOOTHING) * cost;
+	}
+};
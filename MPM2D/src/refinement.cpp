@@ -0,0 +1,148 @@
+#include "refinement.h"
+
+/* Constructors */
+Refinement::Refinement(const Grid& fine)
+{
+	X_TILES = fine.X_TILES;
+	Y_TILES = fine.Y_TILES;
+	tile_inv = fine.h_inv / TILE;
+
+	size_t tlen = (size_t)X_TILES * Y_TILES;
+	Indicator.assign(tlen, 0);
+	Occupied.assign(tlen, 0);
+	Timer.assign(tlen, REFINE_HOLD);						// Start fully refined
+	Refined.assign(tlen, 0);
+	Depth.assign(tlen, 0);
+}
+
+
+
+/* -----------------------------------------------------------------------
+|							REFINEMENT CRITERIA							 |
+----------------------------------------------------------------------- */
+
+
+// T is the velocity gradient of the particle (high deformation rate)
+void Refinement::Mark(const Vector2f& Xp, const Matrix2f& T)
+{
+	int t = Tile(Xp);
+	unsigned char flag;
+
+	// Read first to keep the cache line shared when the tile is already marked
+	#pragma omp atomic read
+	flag = Occupied[t];
+	if (!flag)
+	{
+		#pragma omp atomic write
+		Occupied[t] = 1;
+	}
+
+	double rate = sqrt(T[0][0] * T[0][0] + T[0][1] * T[0][1] + T[1][0] * T[1][0] + T[1][1] * T[1][1]);
+	if (rate > REFINE_STRAIN_RATE)
+	{
+		#pragma omp atomic read
+		flag = Indicator[t];
+		if (!flag)
+		{
+			#pragma omp atomic write
+			Indicator[t] = 1;
+		}
+	}
+}
+
+
+void Refinement::Update()
+{
+	// Free surface: occupied tile next to an empty one
+	for (int ty = 0; ty < Y_TILES; ty++)
+		for (int tx = 0; tx < X_TILES; tx++)
+		{
+			int t = ty * X_TILES + tx;
+			if (!Occupied[t])
+				continue;
+
+			for (int dy = -1; dy <= 1; dy++)
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					int nx = tx + dx, ny = ty + dy;
+					if (nx >= 0 && nx < X_TILES && ny >= 0 && ny < Y_TILES && !Occupied[ny * X_TILES + nx])
+						Indicator[t] = 1;
+				}
+		}
+
+	// Hold refined tiles for REFINE_HOLD steps (no flickering between levels)
+	for (size_t t = 0, tlen = Timer.size(); t < tlen; t++)
+	{
+		if (Indicator[t])
+			Timer[t] = REFINE_HOLD;
+		else if (Timer[t] > 0)
+			Timer[t]--;
+
+		Indicator[t] = 0;
+		Occupied[t] = 0;
+	}
+
+	// Dilate by one tile: the band [1] surrounds every requested tile
+	for (int ty = 0; ty < Y_TILES; ty++)
+		for (int tx = 0; tx < X_TILES; tx++)
+		{
+			unsigned char refined = 0;
+			for (int dy = -1; dy <= 1; dy++)
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					int nx = tx + dx, ny = ty + dy;
+					if (nx >= 0 && nx < X_TILES && ny >= 0 && ny < Y_TILES && Timer[ny * X_TILES + nx] > 0)
+						refined = 1;
+				}
+			Refined[ty * X_TILES + tx] = refined;
+		}
+
+	// Depth: [2] if all the neighbours are refined (outside the grid counts as refined)
+	for (int ty = 0; ty < Y_TILES; ty++)
+		for (int tx = 0; tx < X_TILES; tx++)
+		{
+			int t = ty * X_TILES + tx;
+			if (!Refined[t])
+			{
+				Depth[t] = 0;
+				continue;
+			}
+
+			Depth[t] = 2;
+			for (int dy = -1; dy <= 1; dy++)
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					int nx = tx + dx, ny = ty + dy;
+					if (nx >= 0 && nx < X_TILES && ny >= 0 && ny < Y_TILES && !Refined[ny * X_TILES + nx])
+						Depth[t] = 1;
+				}
+		}
+}
+
+
+
+/* -----------------------------------------------------------------------
+|								RENDERING								 |
+----------------------------------------------------------------------- */
+
+
+void Refinement::DrawRefinement()
+{
+	const double w = 1.0 / tile_inv;
+
+	glLineWidth(1);
+	glColor3f(0.45f, 0.45f, 0.45f);
+
+	glBegin(GL_LINES);
+	for (int ty = 0; ty < Y_TILES; ty++)
+		for (int tx = 0; tx < X_TILES; tx++)
+			if (Depth[ty * X_TILES + tx] == 2)
+			{
+				double x0 = tx * w, y0 = ty * w;
+				glVertex2f(x0, y0); glVertex2f(x0 + w, y0);
+				glVertex2f(x0 + w, y0); glVertex2f(x0 + w, y0 + w);
+				glVertex2f(x0 + w, y0 + w); glVertex2f(x0, y0 + w);
+				glVertex2f(x0, y0 + w); glVertex2f(x0, y0);
+			}
+	glEnd();
+}
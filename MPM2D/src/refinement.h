@@ -0,0 +1,51 @@
+#pragma once
+
+#include "grid.h"
+
+/* The refinement class drives the adaptive (two-level) grid.
+The base grid has cell size h and is only solved where refined, the coarse grid (cell size 2h)
+covers the whole domain. Refinement is tracked per tile of the base grid, with a depth:
+	[0] coarse: particles transfer with the coarse grid only
+	[1] band: particles transfer to the fine grid (P2G) but read the coarse grid (G2P)
+	[2] fine: particles use the fine grid for both transfers
+Fine P2G data is restricted to the coarse grid (cubic B-splines are refinable), so the coarse
+level sees every particle: exactly for mass, velocity and force, conservatively only for the APIC
+affine momentum (see Solver::Restrict). A coarse stencil reaches 2 coarse cells = 4 fine cells, less than the
+width of the band tile, so the fine nodes read by depth 2 particles only get fine contributions. */
+
+class Refinement
+{
+public:
+
+	/* Data */
+	int X_TILES, Y_TILES;									// Tiles of the base grid
+	double tile_inv;										// 1 / tile width (physical units)
+
+	std::vector<unsigned char> Indicator;					// Refinement requested during the last particle update
+	std::vector<unsigned char> Occupied;					// Tile contains particles (free surface detection)
+	std::vector<int> Timer;									// Steps left before a refined tile is coarsened
+	std::vector<unsigned char> Refined;						// Timer > 0, dilated by one tile
+	std::vector<unsigned char> Depth;						// [0] coarse - [1] band - [2] fine
+
+
+
+	/* Constructors */
+	Refinement() {};
+	Refinement(const Grid& fine);
+	~Refinement() {};
+
+
+
+	/* Functions */
+	int Tile(const Vector2f& Xp) const						// Tile containing a position
+	{
+		int tx = std::min(std::max(static_cast<int>(Xp[0] * tile_inv), 0), X_TILES - 1);
+		int ty = std::min(std::max(static_cast<int>(Xp[1] * tile_inv), 0), Y_TILES - 1);
+		return ty * X_TILES + tx;
+	}
+
+	void Mark(const Vector2f& Xp, const Matrix2f& T);		// Record particle indicators (in UpdateParticles)
+	void Update();											// Refined tiles and depths (before P2G)
+
+	void DrawRefinement();									// Outline of the fine (depth 2) tiles
+};
@@ -0,0 +1,92 @@
+#include "scheduler.h"
+
+#include <thread>
+
+/* Constructors */
+Scheduler::~Scheduler()
+{
+	for (size_t q = 0; q < queues.size(); q++)
+		omp_destroy_lock(&queues[q].lock);
+}
+
+
+
+/* -----------------------------------------------------------------------
+|								TASK QUEUES								 |
+----------------------------------------------------------------------- */
+
+
+void Scheduler::Allocate(const int threads)
+{
+	queues = std::vector<TaskQueue>(threads);
+	for (int q = 0; q < threads; q++)
+		omp_init_lock(&queues[q].lock);
+}
+
+
+void Scheduler::Reset(const int tasks)
+{
+	remaining = tasks;
+	for (size_t q = 0; q < queues.size(); q++)
+		queues[q].tasks.clear();
+}
+
+
+// Threads beyond the number of queues (nested teams) share them
+void Scheduler::Push(const int thread, const Task& task)
+{
+	TaskQueue& queue = queues[thread % queues.size()];
+	omp_set_lock(&queue.lock);
+	queue.tasks.push_back(task);
+	omp_unset_lock(&queue.lock);
+}
+
+
+// Back of the own queue (last pushed), else front of the other queues (oldest, the furthest
+// from what their owner works on). Idle threads yield: the graph may still release tasks
+bool Scheduler::Next(const int thread, Task& task)
+{
+	const int qlen = (int)queues.size();
+
+	while (1)
+	{
+		for (int k = 0; k < qlen; k++)
+		{
+			TaskQueue& queue = queues[(thread + k) % qlen];
+			omp_set_lock(&queue.lock);
+			bool found = !queue.tasks.empty();
+			if (found)
+			{
+				if (k == 0)
+				{
+					task = queue.tasks.back();
+					queue.tasks.pop_back();
+				}
+				else
+				{
+					task = queue.tasks.front();
+					queue.tasks.pop_front();
+				}
+			}
+			omp_unset_lock(&queue.lock);
+
+			if (found)
+				return true;
+		}
+
+		int left;
+		#pragma omp atomic read
+		left = remaining;
+		if (left == 0)
+			return false;
+
+		std::this_thread::yield();
+	}
+}
+
+
+void Scheduler::Done()
+{
+	#pragma omp atomic
+	remaining--;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include <omp.h>
+
+/* Work-stealing scheduler of the task graph of a step (see Solver::TaskStep).
+Each thread owns a deque of ready tasks: it takes the last task it pushed (the task it just made
+ready, whose data is still in cache), and idle threads steal the oldest task of another deque.
+A task is pushed once its dependency counter reaches 0 (Release), the step is over when all the
+tasks of the graph are Done. Counters and the task count are updated with OpenMP atomics. */
+
+enum TaskType
+{
+	P2G_TASK,												// Scatter the particles of a tile bin
+	NODE_TASK,												// Update the nodes of a tile
+	G2P_TASK												// Gather and update the particles of a tile bin
+};
+
+
+struct Task
+{
+	TaskType type;
+	int id;													// Index in TileBins (P2G, G2P) or tile (nodes)
+};
+
+
+struct alignas(64) TaskQueue								// Own cache line: no false sharing between threads
+{
+	omp_lock_t lock;
+	std::deque<Task> tasks;
+};
+
+
+class Scheduler
+{
+public:
+
+	/* Data */
+	std::vector<TaskQueue> queues;							// One per thread
+	int remaining;											// Tasks of the graph not done yet
+
+
+
+	/* Constructors */
+	Scheduler() : remaining(0) {};
+	Scheduler(const Scheduler&) = delete;					// Queues own their locks
+	Scheduler& operator=(const Scheduler&) = delete;
+	~Scheduler();
+
+
+
+	/* Functions */
+	void Allocate(const int threads);						// One queue per thread
+	void Reset(const int tasks);							// New graph of a number of tasks (single thread)
+
+	void Push(const int thread, const Task& task);			// Ready task, in the queue of a thread
+	bool Next(const int thread, Task& task);				// Own task, or a stolen one. False once the graph is done
+	void Done();											// Task finished
+
+	static bool Release(int& counter)						// One dependency met. True when it was the last one
+	{
+		int left;
+		#pragma omp atomic capture
+		left = --counter;
+		return left == 0;
+	}
+};
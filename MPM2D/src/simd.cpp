@@ -0,0 +1,244 @@
+#include "simd.h"
+#include "parameters.h"
+
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+
+/* -----------------------------------------------------------------------
+|							ISA DETECTION								 |
+----------------------------------------------------------------------- */
+
+
+bool SimdSupported()
+{
+	#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool fma = (info[2] >> 12) & 1;
+	bool osxsave = (info[2] >> 27) & 1;
+	bool avx = (info[2] >> 28) & 1;
+
+	// The OS has to save the AVX registers
+	if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] >> 5) & 1;
+	#else
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	#endif
+}
+
+
+
+/* -----------------------------------------------------------------------
+|							ROW OPERATIONS								 |
+----------------------------------------------------------------------- */
+
+
+// Used lanes of a row: the NODES of the stencil
+template <int INTERP>
+SIMD_TARGET static inline __m256i RowMask()
+{
+	return _mm256_setr_epi64x(-1, -1, -1, (Spline<INTERP>::NODES == 4) ? -1 : 0);
+}
+
+
+template <int INTERP>
+SIMD_TARGET static inline __m256d Load(const double* X, const __m256i mask)
+{
+	return (Spline<INTERP>::NODES == 4) ? _mm256_loadu_pd(X) : _mm256_maskload_pd(X, mask);
+}
+
+
+template <int INTERP>
+SIMD_TARGET static inline void Store(double* X, const __m256d V, const __m256i mask)
+{
+	if (Spline<INTERP>::NODES == 4)
+		_mm256_storeu_pd(X, V);
+	else
+		_mm256_maskstore_pd(X, mask, V);
+}
+
+
+SIMD_TARGET static inline double Sum(const __m256d V)
+{
+	__m128d S = _mm_add_pd(_mm256_castpd256_pd128(V), _mm256_extractf128_pd(V, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(S, _mm_unpackhi_pd(S, S)));
+}
+
+
+// Force increment Ap * dWip of a row: stress matrix, or pressure (only scaled gradients)
+SIMD_TARGET static inline void Force(const Matrix2f& Ap, const __m256d gx, const __m256d gy, __m256d& f0, __m256d& f1)
+{
+	f0 = _mm256_fmadd_pd(_mm256_set1_pd(Ap[0][0]), gx, _mm256_mul_pd(_mm256_set1_pd(Ap[0][1]), gy));
+	f1 = _mm256_fmadd_pd(_mm256_set1_pd(Ap[1][0]), gx, _mm256_mul_pd(_mm256_set1_pd(Ap[1][1]), gy));
+}
+
+
+SIMD_TARGET static inline void Force(const double Ap, const __m256d gx, const __m256d gy, __m256d& f0, __m256d& f1)
+{
+	const __m256d a = _mm256_set1_pd(Ap);
+	f0 = _mm256_mul_pd(a, gx);
+	f1 = _mm256_mul_pd(a, gy);
+}
+
+
+// Lane k: x = bni + k. Returns a + (bni + k) * h
+template <int INTERP>
+SIMD_TARGET static inline __m256d Lanes(const double a, const double h)
+{
+	const int bni = Spline<INTERP>::bni;
+	return _mm256_setr_pd(a + bni * h, a + (bni + 1) * h, a + (bni + 2) * h, a + (bni + 3) * h);
+}
+
+
+
+/* -----------------------------------------------------------------------
+|								KERNELS									 |
+----------------------------------------------------------------------- */
+
+
+template <int INTERP>
+SIMD_TARGET void G2PKernel(const double* V0, const double* V1, const size_t row[4], const double W[2][4],
+	const Vector2f& dist_base, const double h, Vector2f& Vp, Matrix2f& Bp)
+{
+	typedef Spline<INTERP> S;
+	const __m256i mask = RowMask<INTERP>();
+	const __m256d wx = _mm256_loadu_pd(W[0]);
+	const __m256d ndx = Lanes<INTERP>(-dist_base[0], h);	// - dist, x
+
+	__m256d v0 = _mm256_setzero_pd(), v1 = _mm256_setzero_pd();
+	__m256d b00 = _mm256_setzero_pd(), b01 = _mm256_setzero_pd();
+	__m256d b10 = _mm256_setzero_pd(), b11 = _mm256_setzero_pd();
+
+	for (int j = 0; j < S::NODES; j++)
+	{
+		const __m256d w = _mm256_mul_pd(wx, _mm256_set1_pd(W[1][j]));
+		const __m256d ndy = _mm256_set1_pd((S::bni + j) * h - dist_base[1]);
+
+		const __m256d wv0 = _mm256_mul_pd(w, Load<INTERP>(V0 + row[j], mask));
+		const __m256d wv1 = _mm256_mul_pd(w, Load<INTERP>(V1 + row[j], mask));
+
+		v0 = _mm256_add_pd(v0, wv0);
+		v1 = _mm256_add_pd(v1, wv1);
+		b00 = _mm256_fmadd_pd(wv0, ndx, b00);
+		b01 = _mm256_fmadd_pd(wv0, ndy, b01);
+		b10 = _mm256_fmadd_pd(wv1, ndx, b10);
+		b11 = _mm256_fmadd_pd(wv1, ndy, b11);
+	}
+
+	Vp = Vector2f(Sum(v0), Sum(v1));
+	Bp = Matrix2f(Sum(b00), Sum(b01), Sum(b10), Sum(b11));
+}
+
+
+template <int INTERP, bool TRACE>
+SIMD_TARGET void UpdateKernel(const double* V0, const double* V1, const size_t row[4], const double W[2][4],
+	const double dW[2][4], const Vector2f& X_base, const double h, Vector2f& Xp, Matrix2f& T)
+{
+	typedef Spline<INTERP> S;
+	const __m256i mask = RowMask<INTERP>();
+	const __m256d wx = _mm256_loadu_pd(W[0]);
+	const __m256d dwx = _mm256_loadu_pd(dW[0]);
+	const __m256d xi = Lanes<INTERP>(X_base[0], h);		// Node positions, x
+	const __m256d dt = _mm256_set1_pd(DT);
+
+	__m256d x0 = _mm256_setzero_pd(), x1 = _mm256_setzero_pd();
+	__m256d t00 = _mm256_setzero_pd(), t01 = _mm256_setzero_pd();
+	__m256d t10 = _mm256_setzero_pd(), t11 = _mm256_setzero_pd();
+
+	for (int j = 0; j < S::NODES; j++)
+	{
+		const __m256d wy = _mm256_set1_pd(W[1][j]);
+		const __m256d w = _mm256_mul_pd(wx, wy);
+		const __m256d gx = _mm256_mul_pd(dwx, wy);			// Weight gradient
+		const __m256d gy = _mm256_mul_pd(wx, _mm256_set1_pd(dW[1][j]));
+		const __m256d yi = _mm256_set1_pd(X_base[1] + (S::bni + j) * h);
+
+		const __m256d v0 = Load<INTERP>(V0 + row[j], mask);
+		const __m256d v1 = Load<INTERP>(V1 + row[j], mask);
+
+		// Xp += Wip * (Xi + DT * Vi)
+		x0 = _mm256_fmadd_pd(w, _mm256_fmadd_pd(dt, v0, xi), x0);
+		x1 = _mm256_fmadd_pd(w, _mm256_fmadd_pd(dt, v1, yi), x1);
+
+		// T += Vi (x) dWip
+		t00 = _mm256_fmadd_pd(v0, gx, t00);
+		t11 = _mm256_fmadd_pd(v1, gy, t11);
+		if (!TRACE)
+		{
+			t01 = _mm256_fmadd_pd(v0, gy, t01);
+			t10 = _mm256_fmadd_pd(v1, gx, t10);
+		}
+	}
+
+	Xp = Vector2f(Sum(x0), Sum(x1));
+	T = TRACE ? Matrix2f(Sum(t00), 0.0, 0.0, Sum(t11)) : Matrix2f(Sum(t00), Sum(t01), Sum(t10), Sum(t11));
+}
+
+
+template <int INTERP, class STRESS>
+SIMD_TARGET void P2GKernel(double* M, double* V0, double* V1, double* F0, double* F1, const size_t row[4],
+	const double W[2][4], const double dW[2][4], const Vector2f& dist_base, const double h,
+	const double Mp, const Vector2f& Vp, const Matrix2f& Cp, const STRESS& Ap)
+{
+	typedef Spline<INTERP> S;
+	const __m256i mask = RowMask<INTERP>();
+	const __m256d wx = _mm256_loadu_pd(W[0]);
+	const __m256d dwx = _mm256_loadu_pd(dW[0]);
+	const __m256d ndx = Lanes<INTERP>(-dist_base[0], h);	// - dist, x
+	const __m256d mp = _mm256_set1_pd(Mp);
+
+	for (int j = 0; j < S::NODES; j++)
+	{
+		const double ndy = (S::bni + j) * h - dist_base[1];	// - dist, y
+		const __m256d wy = _mm256_set1_pd(W[1][j]);
+		const __m256d wm = _mm256_mul_pd(mp, _mm256_mul_pd(wx, wy));
+		const __m256d gx = _mm256_mul_pd(dwx, wy);
+		const __m256d gy = _mm256_mul_pd(wx, _mm256_set1_pd(dW[1][j]));
+
+		// Velocity (APIC): Vp + Cp * (-dist)
+		const __m256d u0 = _mm256_fmadd_pd(_mm256_set1_pd(Cp[0][0]), ndx, _mm256_set1_pd(Vp[0] + Cp[0][1] * ndy));
+		const __m256d u1 = _mm256_fmadd_pd(_mm256_set1_pd(Cp[1][0]), ndx, _mm256_set1_pd(Vp[1] + Cp[1][1] * ndy));
+
+		// Force: Ap * dWip
+		__m256d f0, f1;
+		Force(Ap, gx, gy, f0, f1);
+
+		const size_t i = row[j];
+		Store<INTERP>(M + i, _mm256_add_pd(Load<INTERP>(M + i, mask), wm), mask);
+		Store<INTERP>(V0 + i, _mm256_fmadd_pd(wm, u0, Load<INTERP>(V0 + i, mask)), mask);
+		Store<INTERP>(V1 + i, _mm256_fmadd_pd(wm, u1, Load<INTERP>(V1 + i, mask)), mask);
+		Store<INTERP>(F0 + i, _mm256_add_pd(Load<INTERP>(F0 + i, mask), f0), mask);
+		Store<INTERP>(F1 + i, _mm256_add_pd(Load<INTERP>(F1 + i, mask), f1), mask);
+	}
+}
+
+
+template void G2PKernel<1>(const double*, const double*, const size_t[4], const double[2][4],
+	const Vector2f&, const double, Vector2f&, Matrix2f&);
+template void G2PKernel<2>(const double*, const double*, const size_t[4], const double[2][4],
+	const Vector2f&, const double, Vector2f&, Matrix2f&);
+
+#define INSTANTIATE_UPDATE(INTERP, TRACE)																\
+template void UpdateKernel<INTERP, TRACE>(const double*, const double*, const size_t[4], const double[2][4],	\
+	const double[2][4], const Vector2f&, const double, Vector2f&, Matrix2f&);
+INSTANTIATE_UPDATE(1, false)
+INSTANTIATE_UPDATE(1, true)
+INSTANTIATE_UPDATE(2, false)
+INSTANTIATE_UPDATE(2, true)
+
+#define INSTANTIATE_P2G(INTERP, STRESS)																	\
+template void P2GKernel<INTERP, STRESS>(double*, double*, double*, double*, double*, const size_t[4],		\
+	const double[2][4], const double[2][4], const Vector2f&, const double, const double, const Vector2f&,	\
+	const Matrix2f&, const STRESS&);
+INSTANTIATE_P2G(1, Matrix2f)
+INSTANTIATE_P2G(1, double)
+INSTANTIATE_P2G(2, Matrix2f)
+INSTANTIATE_P2G(2, double)
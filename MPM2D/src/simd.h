@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+
+#include "constants.h"
+#include "spline.h"
+
+/* Vectorized stencil kernels (AVX2). A stencil row is one register of 4 doubles: the 4 nodes of
+a cubic spline, or the 3 nodes of a quadratic spline with masked loads and stores (the 4th node
+is never touched). Rows have to be contiguous in memory: rows crossing a periodic side use the
+scalar loops of the solver. The instruction set is detected at runtime, the scalar loops are
+also used when the CPU does not support AVX2 and FMA. Kernels are instantiated for both
+interpolation types (INTERP, see spline.h).
+
+row[j]: index of the first node of stencil row j (y = bni + j). W, dW: separable weights of the
+stencil (see Solver::StencilWeights). dist_base: particle - base node. Node (x, y) of the stencil
+is at base node + (x, y) * h. */
+
+// Kernels are compiled for AVX2 + FMA whatever the target of the build (GCC, Clang)
+#if defined(_MSC_VER)
+#define SIMD_TARGET
+#else
+#define SIMD_TARGET __attribute__((target("avx2,fma")))
+#endif
+
+
+bool SimdSupported();										// AVX2 and FMA, CPU and OS
+
+// Velocity and APIC field of a particle
+template <int INTERP>
+SIMD_TARGET void G2PKernel(const double* V0, const double* V1,
+	const size_t row[4], const double W[2][4],
+	const Vector2f& dist_base, const double h,
+	Vector2f& Vp, Matrix2f& Bp);
+
+// New position and nodal deformation T of a particle (TRACE: diagonal of T only)
+template <int INTERP, bool TRACE>
+SIMD_TARGET void UpdateKernel(const double* V0, const double* V1,
+	const size_t row[4], const double W[2][4], const double dW[2][4],
+	const Vector2f& X_base, const double h,
+	Vector2f& Xp, Matrix2f& T);
+
+// Mass, momentum and force of a particle (plain adds: colored or private P2G).
+// STRESS: type of Ap, Matrix2f or double (pressure)
+template <int INTERP, class STRESS>
+SIMD_TARGET void P2GKernel(double* M, double* V0, double* V1, double* F0, double* F1,
+	const size_t row[4], const double W[2][4], const double dW[2][4],
+	const Vector2f& dist_base, const double h,
+	const double Mp, const Vector2f& Vp, const Matrix2f& Cp, const STRESS& Ap);
@@ -1,15 +1,69 @@
 #include "solver.h"
 
 /* Constructors */
-Solver::Solver(const std::vector<Border>& inBorders, const std::vector<Node>& inNodes,
-	const std::vector<Material>& inParticles)
+Solver::Solver(const std::vector<Border>& inBorders, const std::vector<Collider>& inColliders,
+	const Grid& inGrid, const std::vector<Material>& inParticles, const Domain& inDomain, const int inThreads)
 {
+	// Per-thread state (task queues, private grids) for the threads of its steps only
+	const int threads = (inThreads > 0) ? inThreads : omp_get_max_threads();
+
+	domain = inDomain;
 	borders = inBorders;
-	nodes = inNodes;
-	particles = inParticles;
+	colliders = inColliders;
+	time = 0.0;
+	stop_time = DT_render;
+	on_stop = false;
+	grid = inGrid;
+	particles.assign(inParticles.begin(), inParticles.end());
 
 	blen = borders.size();
-	ilen = nodes.size();
+	ilen = grid.ilen;
+
+	// Coarse level: cell size 2h, padded so that coarse stencils stay inside
+	if (ADAPTIVE_GRID)
+	{
+		coarse = Grid(grid.nx / 2 + 1 + 2 * COARSE_PAD, grid.ny / 2 + 1 + 2 * COARSE_PAD,
+			2.0 * grid.h, borders, COARSE_PAD);
+		refinement = Refinement(grid);
+		RestrictActive.assign((size_t)coarse.X_TILES * coarse.Y_TILES, 0);
+	}
+
+	if (DOUBLE_BUFFER_GRID)
+	{
+		grid.AllocateBackBuffer();
+		if (ADAPTIVE_GRID)
+			coarse.AllocateBackBuffer();
+	}
+
+	if (!colliders.empty())
+	{
+		grid.AllocateColliders();
+		if (ADAPTIVE_GRID)
+			coarse.AllocateColliders();
+	}
+
+	if (TASK_GRAPH)
+		scheduler.Allocate(threads);
+
+	// Thread-private grids: mass, momentum and force per node and per thread
+	if (P2G_MODE == 2)
+	{
+		size_t nodes = grid.ilen + (ADAPTIVE_GRID ? coarse.ilen : 0);
+		double memory = threads * nodes * (5 * sizeof(double)) / (1024.0 * 1024.0);
+
+		if (memory > PRIVATE_GRID_BUDGET)
+		{
+			std::cerr << "Thread-private grids need " << memory << " MB (budget " << PRIVATE_GRID_BUDGET
+				<< " MB): colored P2G used instead" << std::endl;
+			P2G_MODE = 1;
+		}
+		else
+		{
+			grid.AllocatePrivate(threads);
+			if (ADAPTIVE_GRID)
+				coarse.AllocatePrivate(threads);
+		}
+	}
 }
 
 
@@ -19,119 +73,855 @@ Solver::Solver(const std::vector<Border>& inBorders, const std::vector<Node>& in
 ----------------------------------------------------------------------- */
 
 
+// The threads are forked once per step. Phases are separated by the implicit barriers of their
+// worksharing loops and single sections, and each loop splits its own range among the team.
+// The grid is reset at the start of the step: it stays readable until then (drawing, output)
+void Solver::Step()
+{
+	#pragma omp parallel
+	{
+		if (ADAPTIVE_TIME_STEP)
+			ChooseTimeStep();
+		ResetGrid();
+		if (TASK_GRAPH)
+			TaskStep();
+		else
+		{
+			P2G();
+
+			// Halo sums of the neighbours, then the velocities of their nodes in our halos
+			if (domain.ranks > 1)
+			{
+				#pragma omp single
+				{
+					domain.SumHalos(grid);
+					grid.BuildActiveTiles();
+				}
+			}
+			UpdateNodes();
+			if (domain.ranks > 1)
+			{
+				#pragma omp single
+				domain.CopyHalos(grid);
+			}
+
+			G2P();
+			UpdateParticles();
+		}
+	}
+
+	if (domain.ranks > 1)
+		domain.Migrate(particles);
+}
+
+
+
+// The step is bounded by the particle speed (a particle moves CFL_SPEED cells at most) and by the
+// elastic waves (CFL_WAVE cells per step), explicit integration being unstable beyond. A step
+// ending close after a frame is cut to end on it: a step ending less than a step before the frame
+// is split in two halves instead of leaving a tiny step
+void Solver::ChooseTimeStep()
+{
+	#pragma omp single
+	{
+		max_speed = 0;
+		max_wave = 0;
+	}
+
+	double speed = 0, wave = 0;
+
+	#pragma omp for nowait
+	for (int p = 0; p < (int)particles.size(); p++)
+	{
+		speed = std::max(speed, particles[p].Vp.norm());
+		wave = std::max(wave, particles[p].WaveSpeed());
+	}
+
+	#pragma omp critical
+	{
+		max_speed = std::max(max_speed, speed);
+		max_wave = std::max(max_wave, wave);
+	}
+
+	#pragma omp barrier
+
+	#pragma omp single
+	{
+		double dt = DT_MAX;
+		if (max_speed > 0)
+			dt = std::min(dt, CFL_SPEED * H / max_speed);
+		if (max_wave > 0)
+			dt = std::min(dt, CFL_WAVE * H / max_wave);
+		dt = std::max(dt, DT_MIN);
+
+		double left = stop_time - time;
+		on_stop = (dt >= left);
+		DT = on_stop ? left : (2 * dt > left ? 0.5 * left : dt);
+	}
+}
+
+
+// The stop time is set rather than summed: frames land on their exact times
+void Solver::AdvanceTime()
+{
+	if (ADAPTIVE_TIME_STEP && on_stop)
+	{
+		time = stop_time;
+		stop_time += DT_render;
+	}
+	else
+		time += DT;
+}
+
+
 // Transfer from Particles to Grid nodes
-void Solver::P2G()				
+void Solver::P2G()
 {
-	// plen is computed here for when we add particles mid-simulaion
-	plen = particles.size();							
+	if (INTERPOLATION_MODE == 1)
+		P2G<1>();
+	else
+		P2G<2>();
+}
 
-	#pragma omp parallel for 
-	for (int p = 0; p < plen; p++)
+
+template <int INTERP>
+void Solver::P2G()
+{
+	#pragma omp single
 	{
-		// Pre-update Ap (in particle loop)
-		particles[p].ConstitutiveModel();				
+		// plen is computed here for when we add particles mid-simulaion
+		plen = particles.size();
+		Level.resize(plen, 0);
 
-		// Index of bottom-left node closest to the particle
-		int node_base =									
-			(X_GRID + 1) * static_cast<int>(particles[p].Xp[1] - Translation_xp[1])
-			+ static_cast<int>(particles[p].Xp[0] - Translation_xp[0]);
+		if (ADAPTIVE_GRID)
+			refinement.Update();
+	}
 
-		// Loop over all the close nodes (depend on interpolation through bni)
-		for (int y = bni; y < 3; y++) {					
-			for (int x = bni; x < 3; x++)
-			{			
-				// Index of the node
-				int node_id = node_base + x + (X_GRID + 1) * y;
+	if (P2G_MODE == 1)
+		ColoredP2G<INTERP>();
+	else if (P2G_MODE == 3)
+		GatherP2G<INTERP>();
+	else if (P2G_MODE == 4)
+		TiledP2G<INTERP>();
+	else
+	{
+		#pragma omp for
+		for (int p = 0; p < plen; p++)
+		{
+			// Pre-update Ap (in particle loop)
+			particles[p].ConstitutiveModel();
+			if (P2G_MODE == 2)
+				ScatterParticle<INTERP, 2>(p);
+			else
+				ScatterParticle<INTERP, 0>(p);
+		}
+	}
 
-				// Distance and weight
-				Vector2f dist = particles[p].Xp - nodes[node_id].Xi;		
-				double Wip = getWip(dist);
-				Vector2f dWip = getdWip(dist);
+	#pragma omp single
+	grid.BuildActiveTiles();
+	if (P2G_MODE == 2)
+		grid.ReducePrivate();
 
-				// Pre-compute node mass, node velocity and pre-update force increment (APIC)
-				double inMi = Wip * particles[p].Mp;							
-				Vector2f inVi = Wip * particles[p].Mp *
-					(particles[p].Vp + Dp_scal * H_INV * H_INV * particles[p].Bp * (-dist));
+	if (ADAPTIVE_GRID)
+	{
+		if (P2G_MODE == 2)
+		{
+			#pragma omp single
+			coarse.BuildActiveTiles();
+			coarse.ReducePrivate();
+		}
+		Restrict();
 
-				Vector2f inFi = particles[p].Ap * dWip;
+		#pragma omp single
+		coarse.BuildActiveTiles();
+	}
+}
 
-				// Udpate mass, velocity and force 
-				// (atomic operation because 2 particles (i.e threads) can have nodes in commun)
+
+// [0] Atomic: particles of any position run concurrently. [1] Colored: the caller guarantees that
+// no other thread writes the stencil nodes of p. [2] Private: written in the grid of the thread.
+// [4] Tiled: written in the scratchpad of the tile of p
+template <int INTERP, int MODE>
+void Solver::ScatterParticle(const int p, Scratchpad* pad)
+{
+	typedef Spline<INTERP> S;
+
+	// Bp was computed on the level read in the last G2P: C = Dp^-1 * Bp on that level
+	double h_inv = LevelGrid(Level[p]).h_inv;
+	Matrix2f Cp = S::Dp_scal * h_inv * h_inv * particles[p].Bp;
+
+	// Level of the transfers (see refinement.h)
+	int depth = ADAPTIVE_GRID ? refinement.Depth[refinement.Tile(particles[p].Xp)] : 2;
+	Level[p] = (depth == 2) ? 0 : 1;
+	Grid& g = LevelGrid(depth >= 1 ? 0 : 1);
+
+	// Index of bottom-left node closest to the particle
+	int x_base, y_base;
+	g.StencilBase<INTERP>(particles[p].Xp, x_base, y_base);
+
+	// Accumulation target: the grid, the private grid of the thread, or the scratchpad
+	const int thread = (MODE == 2) ? omp_get_thread_num() : -1;
+	double* M = g.Mi.data();
+	double* V[2] = { g.Vi[0].data(), g.Vi[1].data() };
+	double* F[2] = { g.Fi[0].data(), g.Fi[1].data() };
+	if (MODE == 2)
+	{
+		M = g.PrivateM[thread].data();
+		V[0] = g.PrivateV[0][thread].data(); V[1] = g.PrivateV[1][thread].data();
+		F[0] = g.PrivateF[0][thread].data(); F[1] = g.PrivateF[1][thread].data();
+	}
+	else if (MODE == 4)
+	{
+		M = pad->M;
+		V[0] = pad->V[0]; V[1] = pad->V[1];
+		F[0] = pad->F[0]; F[1] = pad->F[1];
+	}
+
+	// Record the tiles touched by the stencil (active list for the grid phases)
+	g.ActivateStencil<INTERP>(x_base, y_base, thread);
+
+	// Separable weights
+	Vector2f dist_base = particles[p].Xp - g.NodePosition(x_base, y_base);
+	double W[2][4], dW[2][4];
+	StencilWeights<INTERP>(dist_base, g.h_inv, W, dW);
+
+	// Vectorized kernel: one stencil row per instruction (plain adds only)
+	if (MODE != 0 && SIMD_KERNELS && (MODE == 4 || g.ContiguousRows<INTERP>(x_base)))
+	{
+		size_t row[4];
+		if (MODE == 4)
+			StencilRows<INTERP>(*pad, x_base, y_base, row);
+		else
+			StencilRows<INTERP>(g, x_base, y_base, row);
+		P2GKernel<INTERP>(M, V[0], V[1], F[0], F[1], row, W, dW, dist_base, g.h, particles[p].Mp,
+			particles[p].Vp, Cp, particles[p].Ap);
+		return;
+	}
+
+	// Loop over all the close nodes (compile-time bounds: unrolled)
+	for (int y = S::bni; y < 3; y++) {
+		for (int x = S::bni; x < 3; x++)
+		{
+			// Index of the node (wrapped on periodic sides, or in the scratchpad)
+			size_t node_id = (MODE == 4) ? pad->Index(x_base + x, y_base + y) : g.StencilNode(x_base + x, y_base + y);
+
+			// Distance and weight
+			Vector2f dist = dist_base - Vector2f(x * g.h, y * g.h);
+			double Wip = W[0][x - S::bni] * W[1][y - S::bni];
+			Vector2f dWip = Vector2f(dW[0][x - S::bni] * W[1][y - S::bni], W[0][x - S::bni] * dW[1][y - S::bni]);
+
+			// Pre-compute node mass, node velocity and pre-update force increment (APIC)
+			double inMi = Wip * particles[p].Mp;
+			Vector2f inVi = Wip * particles[p].Mp *
+				(particles[p].Vp + Cp * (-dist));
+
+			// (overloaded: stress matrix, or pressure times the gradient for water)
+			Vector2f inFi = particles[p].Ap * dWip;
+
+			// Udpate mass, velocity and force
+			// (atomic operation because 2 particles (i.e threads) can have nodes in commun)
+			if (MODE == 0)
+			{
 				#pragma omp atomic
-				nodes[node_id].Mi += inMi;
+				M[node_id] += inMi;
 
 				#pragma omp atomic
-				nodes[node_id].Vi[0] += inVi[0];
+				V[0][node_id] += inVi[0];
 				#pragma omp atomic
-				nodes[node_id].Vi[1] += inVi[1];
+				V[1][node_id] += inVi[1];
 
 				#pragma omp atomic
-				nodes[node_id].Fi[0] += inFi[0];
+				F[0][node_id] += inFi[0];
 				#pragma omp atomic
-				nodes[node_id].Fi[1] += inFi[1];
+				F[1][node_id] += inFi[1];
+			}
+			else
+			{
+				M[node_id] += inMi;
+				V[0][node_id] += inVi[0];
+				V[1][node_id] += inVi[1];
+				F[0][node_id] += inFi[0];
+				F[1][node_id] += inFi[1];
+			}
+		}
+	}
+}
+
+
+// Grid level of the P2G of a particle (see refinement.h)
+int Solver::P2GLevel(const int p) const
+{
+	int depth = ADAPTIVE_GRID ? refinement.Depth[refinement.Tile(particles[p].Xp)] : 2;
+	return (depth >= 1) ? 0 : 1;
+}
+
+
+// Cell of a particle: node of its stencil base on its P2G level (wrapped on periodic sides).
+// Cells of the coarse level follow the ones of the fine level
+template <int INTERP>
+void Solver::BinParticle(const int p, const bool tiles)
+{
+	const int level = P2GLevel(p);
+	const Grid& g = LevelGrid(level);
+
+	g.StencilBase<INTERP>(particles[p].Xp, Base[0][p], Base[1][p]);
+	size_t i = g.StencilNode(Base[0][p], Base[1][p]);
+
+	if (tiles)
+	{
+		int x = (int)(i % (g.nx + 1)), y = (int)(i / (g.nx + 1));
+		Cell[p] = (y / TILE) * g.X_TILES + x / TILE + (level ? grid.X_TILES * grid.Y_TILES : 0);
+	}
+	else
+		Cell[p] = (int)i + (level ? (int)grid.ilen : 0);
+}
+
+
+// Counting sort of the particles by cell (stable: particles of a cell stay in index order)
+void Solver::SortCells(const bool tiles)
+{
+	const size_t cells = tiles ?
+		(size_t)grid.X_TILES * grid.Y_TILES + (ADAPTIVE_GRID ? (size_t)coarse.X_TILES * coarse.Y_TILES : 0) :
+		grid.ilen + (ADAPTIVE_GRID ? coarse.ilen : 0);
+
+	CellStart.assign(cells + 1, 0);
+	for (int p = 0; p < plen; p++)
+		CellStart[Cell[p] + 1]++;
+	for (size_t c = 0; c < cells; c++)
+		CellStart[c + 1] += CellStart[c];
+
+	CellParticles.resize(plen);
+	std::vector<int> next(CellStart.begin(), CellStart.end() - 1);
+	for (int p = 0; p < plen; p++)
+		CellParticles[next[Cell[p]]++] = p;
+
+	// Tiles holding particles
+	if (tiles)
+	{
+		TileBins.clear();
+		for (size_t c = 0; c < cells; c++)
+			if (CellStart[c + 1] > CellStart[c])
+				TileBins.push_back((int)c);
+	}
+}
+
+
+// Particles are binned by cell, then the blocks of one color (see Grid::BuildBlocks) are
+// scattered in parallel with plain adds, one color after the other. Each block is done by
+// a single thread in cell order: node sums do not depend on the number of threads.
+template <int INTERP>
+void Solver::ColoredP2G()
+{
+	#pragma omp single
+	{
+		Cell.resize(plen);
+		Base[0].resize(plen);
+		Base[1].resize(plen);
+	}
+
+	#pragma omp for
+	for (int p = 0; p < plen; p++)
+	{
+		particles[p].ConstitutiveModel();
+		BinParticle<INTERP>(p);
+	}
+
+	#pragma omp single
+	SortCells();
+
+	// Colored passes, level by level
+	for (int level = 0; level < (ADAPTIVE_GRID ? 2 : 1); level++)
+	{
+		const Grid& g = LevelGrid(level);
+		const int first = level ? (int)grid.ilen : 0;
+
+		for (int c = 0; c < g.colors; c++)
+		{
+			const std::vector<int>& color_blocks = g.ColorBlocks[c];
+
+			// Implicit barrier: the next color starts once this one is done
+			#pragma omp for schedule (dynamic)
+			for (int k = 0; k < (int)color_blocks.size(); k++)
+			{
+				int x0, x1, y0, y1;
+				g.BlockRange(color_blocks[k], x0, x1, y0, y1);
+
+				// The cells of a block row are contiguous
+				for (int y = y0; y <= y1; y++)
+					for (int q = CellStart[first + g.NodeIndex(x0, y)]; q < CellStart[first + g.NodeIndex(x1, y) + 1]; q++)
+						ScatterParticle<INTERP, 1>(CellParticles[q]);
+			}
+		}
+	}
+}
+
+
+// Pull instead of push: each node sums the contributions of the particles of the cells whose
+// stencil covers it. A node is written once, by one thread: no atomics and no coloring, at the
+// cost of evaluating each particle-node weight from the node side
+template <int INTERP>
+void Solver::GatherP2G()
+{
+	typedef Spline<INTERP> S;
+
+	#pragma omp single
+	{
+		Cell.resize(plen);
+		Base[0].resize(plen);
+		Base[1].resize(plen);
+		Cp.resize(plen);
+		Weights.resize(16 * (size_t)plen);
+	}
+
+	#pragma omp for
+	for (int p = 0; p < plen; p++)
+	{
+		particles[p].ConstitutiveModel();
+
+		// Bp was computed on the level read in the last G2P: C = Dp^-1 * Bp on that level
+		double h_inv = LevelGrid(Level[p]).h_inv;
+		Cp[p] = S::Dp_scal * h_inv * h_inv * particles[p].Bp;
+
+		// Level of the transfers (see refinement.h)
+		int depth = ADAPTIVE_GRID ? refinement.Depth[refinement.Tile(particles[p].Xp)] : 2;
+		Level[p] = (depth == 2) ? 0 : 1;
+
+		BinParticle<INTERP>(p);
+		Grid& g = LevelGrid(P2GLevel(p));
+		g.ActivateStencil<INTERP>(Base[0][p], Base[1][p]);
+
+		// Weights of the whole stencil, read node by node in the gather
+		double W[2][4], dW[2][4];
+		StencilWeights<INTERP>(particles[p].Xp - g.NodePosition(Base[0][p], Base[1][p]), g.h_inv, W, dW);
+		std::copy(&W[0][0], &W[0][0] + 8, &Weights[16 * (size_t)p]);
+		std::copy(&dW[0][0], &dW[0][0] + 8, &Weights[16 * (size_t)p + 8]);
+	}
+
+	#pragma omp single
+	SortCells();
+
+	for (int level = 0; level < (ADAPTIVE_GRID ? 2 : 1); level++)
+	{
+		Grid& g = LevelGrid(level);
+		const int first = level ? (int)grid.ilen : 0;
+
+		#pragma omp single
+		g.BuildActiveTiles();
+
+		#pragma omp for schedule (dynamic)
+		for (int a = 0; a < (int)g.ActiveTiles.size(); a++)
+		{
+			int x0, x1, y0, y1;
+			g.TileRange(g.ActiveTiles[a], x0, x1, y0, y1);
+
+			for (int y = y0; y < y1; y++)
+			{
+				for (int x = x0; x < x1; x++)
+				{
+					// Last node of a periodic axis: image of node 0
+					if ((g.periodic[0] && x == g.nx) || (g.periodic[1] && y == g.ny))
+						continue;
+
+					double inMi = 0.0;
+					Vector2f inVi, inFi;
+
+					// Cells (stencil bases) whose stencil covers the node
+					for (int ky = S::bni; ky < 3; ky++)
+					{
+						int cy = y - ky;
+						if (g.periodic[1])
+							cy = Grid::Wrap(cy, g.ny);
+						else if (cy < 0 || cy > g.ny)
+							continue;
+
+						for (int kx = S::bni; kx < 3; kx++)
+						{
+							int cx = x - kx;
+							if (g.periodic[0])
+								cx = Grid::Wrap(cx, g.nx);
+							else if (cx < 0 || cx > g.nx)
+								continue;
+
+							int cell = first + (int)g.NodeIndex(cx, cy);
+							for (int q = CellStart[cell]; q < CellStart[cell + 1]; q++)
+							{
+								int p = CellParticles[q];
+
+								// Node position seen from the particle (unwrapped)
+								Vector2f dist = particles[p].Xp - g.NodePosition(Base[0][p] + kx, Base[1][p] + ky);
+								const double* W = &Weights[16 * (size_t)p];		// W[0], W[1], dW[0], dW[1]
+								double Wip = W[kx - S::bni] * W[4 + ky - S::bni];
+								Vector2f dWip = Vector2f(W[8 + kx - S::bni] * W[4 + ky - S::bni], W[kx - S::bni] * W[12 + ky - S::bni]);
+
+								inMi += Wip * particles[p].Mp;
+								inVi += Wip * particles[p].Mp * (particles[p].Vp + Cp[p] * (-dist));
+								inFi += particles[p].Ap * dWip;
+							}
+						}
+					}
+
+					size_t i = g.NodeIndex(x, y);
+					g.Mi[i] += inMi;
+					Grid::Set(g.Vi, i, Grid::Get(g.Vi, i) + inVi);
+					Grid::Set(g.Fi, i, Grid::Get(g.Fi, i) + inFi);
+				}
+			}
+		}
+	}
+}
+
+
+// Particles are binned by tile. A thread takes a tile, scatters its particles in its scratchpad
+// (tile and halo: a few KB, contiguous), then adds it to the grid: atomics are only needed on
+// the halo shared with the neighbour tiles (see Grid::FlushScratchpad)
+template <int INTERP>
+void Solver::TiledP2G()
+{
+	#pragma omp single
+	{
+		Cell.resize(plen);
+		Base[0].resize(plen);
+		Base[1].resize(plen);
+	}
+
+	#pragma omp for
+	for (int p = 0; p < plen; p++)
+	{
+		particles[p].ConstitutiveModel();
+		BinParticle<INTERP>(p, true);
+	}
+
+	#pragma omp single
+	{
+		SortCells(true);
+		if (DETERMINISTIC_SUMS)
+		{
+			BuildTileUsers<INTERP>();
+			BinPads.resize(TileBins.size());
+		}
+	}
+
+	// Bins of the coarse level follow the ones of the fine level
+	const int fine_tiles = grid.X_TILES * grid.Y_TILES;
+	Scratchpad pad;										// One per thread
+
+	#pragma omp for schedule (dynamic)
+	for (int k = 0; k < (int)TileBins.size(); k++)
+	{
+		const int b = TileBins[k];
+		const int level = (b >= fine_tiles) ? 1 : 0;
+		const int t = b - (level ? fine_tiles : 0);
+		Grid& g = LevelGrid(level);
+		Scratchpad& target = DETERMINISTIC_SUMS ? BinPads[k] : pad;
+
+		g.LoadScratchpad<INTERP>(t, target);
+		for (int q = CellStart[b]; q < CellStart[b + 1]; q++)
+			ScatterParticle<INTERP, 4>(CellParticles[q], &target);
+		if (!DETERMINISTIC_SUMS)
+			g.FlushScratchpad<INTERP>(t, pad);
+	}
+
+	// Deterministic sums: each tile adds the scratchpads covering it, in bin order
+	if (DETERMINISTIC_SUMS)
+	{
+		#pragma omp for schedule (dynamic)
+		for (int t = 0; t < (int)TileUsersStart.size() - 1; t++)
+		{
+			const int count = TileUsersStart[t + 1] - TileUsersStart[t];
+			if (count == 0)
+				continue;
+
+			const int level = (t >= fine_tiles) ? 1 : 0;
+			LevelGrid(level).SumScratchpads(t - (level ? fine_tiles : 0), BinPads, &TileUsers[TileUsersStart[t]], count);
+		}
+	}
+}
+
+
+// Tiles written by the scratchpad of each bin, and the bins writing each tile in bin order (the
+// order of the deterministic sums). Tiles of the coarse level follow the ones of the fine level
+template <int INTERP>
+void Solver::BuildTileUsers()
+{
+	const int bins = (int)TileBins.size();
+	const int fine_tiles = grid.X_TILES * grid.Y_TILES;
+	const int tiles = fine_tiles + (ADAPTIVE_GRID ? coarse.X_TILES * coarse.Y_TILES : 0);
+
+	BinTileCount.resize(bins);
+	BinTiles.resize(9 * (size_t)bins);
+	TileUsersStart.assign(tiles + 1, 0);
+
+	for (int k = 0; k < bins; k++)
+	{
+		const int level = (TileBins[k] >= fine_tiles) ? 1 : 0;
+		const int first = level ? fine_tiles : 0;
+		int* bin_tiles = &BinTiles[9 * (size_t)k];
+
+		BinTileCount[k] = LevelGrid(level).ScratchpadTiles<INTERP>(TileBins[k] - first, bin_tiles);
+		for (int j = 0; j < BinTileCount[k]; j++)
+		{
+			bin_tiles[j] += first;
+			TileUsersStart[bin_tiles[j] + 1]++;
+		}
+	}
+
+	for (int t = 0; t < tiles; t++)
+		TileUsersStart[t + 1] += TileUsersStart[t];
+	TileUsers.resize(TileUsersStart[tiles]);
+	std::vector<int> next(TileUsersStart.begin(), TileUsersStart.end() - 1);
+	for (int k = 0; k < bins; k++)
+		for (int j = 0; j < BinTileCount[k]; j++)
+			TileUsers[next[BinTiles[9 * (size_t)k + j]]++] = k;
+}
+
+
+// Cubic B-splines are refinable: N(x / 2) = sum_k s_k N(x - k), s = (1, 4, 6, 4, 1) / 8.
+// Coarse node I gathers the fine nodes 2I + k with weights s_kx * s_ky, which gives exactly
+// the mass, the velocity part of the momentum and the force (gradient of the refinement relation)
+// a direct P2G on the coarse grid would have. The APIC affine part m C (x_i - x_p) is not exact:
+// it is weighted by the fine node positions 2I + k instead of I, an error of m C sum_k s_k
+// N_2I+k (x_2I+k - X_I) per node. It is conservative (both sum to zero over the nodes).
+void Solver::Restrict()
+{
+	static const double S[5] = { 1 / 8.0, 4 / 8.0, 6 / 8.0, 4 / 8.0, 1 / 8.0 };
+	const int off = coarse.offset[1];					// (same on both axes: no slab with the adaptive grid)
+
+	// Coarse tiles covering the fine active tiles
+	#pragma omp single
+	{
+		RestrictTiles.clear();
+		for (size_t a = 0, alen = grid.ActiveTiles.size(); a < alen; a++)
+		{
+			int x0, x1, y0, y1;
+			grid.TileRange(grid.ActiveTiles[a], x0, x1, y0, y1);
+
+			int cx0 = std::max(x0 / 2 + off - 1, 0), cx1 = std::min((x1 - 1) / 2 + off + 1, coarse.nx);
+			int cy0 = std::max(y0 / 2 + off - 1, 0), cy1 = std::min((y1 - 1) / 2 + off + 1, coarse.ny);
+			coarse.ActivateRange(cx0, cx1, cy0, cy1);
+
+			for (int ty = cy0 / TILE; ty <= cy1 / TILE; ty++)
+				for (int tx = cx0 / TILE; tx <= cx1 / TILE; tx++)
+				{
+					int t = ty * coarse.X_TILES + tx;
+					if (!RestrictActive[t])
+					{
+						RestrictActive[t] = 1;
+						RestrictTiles.push_back(t);
+					}
+				}
+		}
+	}
+
+	// Gather (each coarse node is written by one thread)
+	#pragma omp for schedule (dynamic)
+	for (int a = 0; a < (int)RestrictTiles.size(); a++)
+	{
+		int x0, x1, y0, y1;
+		coarse.TileRange(RestrictTiles[a], x0, x1, y0, y1);
+		RestrictActive[RestrictTiles[a]] = 0;
+
+		for (int y = y0; y < y1; y++)
+		{
+			for (int x = x0; x < x1; x++)
+			{
+				double inMi = 0.0;
+				Vector2f inVi, inFi;
+
+				for (int ky = -2; ky <= 2; ky++)
+				{
+					int fy = 2 * (y - off) + ky;
+					if (fy < 0 || fy > grid.ny)
+						continue;
+
+					for (int kx = -2; kx <= 2; kx++)
+					{
+						int fx = 2 * (x - off) + kx;
+						if (fx < 0 || fx > grid.nx)
+							continue;
+
+						size_t j = grid.NodeIndex(fx, fy);
+						double s = S[kx + 2] * S[ky + 2];
+						inMi += s * grid.Mi[j];
+						inVi += s * Grid::Get(grid.Vi, j);
+						inFi += s * Grid::Get(grid.Fi, j);
+					}
+				}
+
+				size_t i = coarse.NodeIndex(x, y);
+				coarse.Mi[i] += inMi;
+				Grid::Set(coarse.Vi, i, Grid::Get(coarse.Vi, i) + inVi);
+				Grid::Set(coarse.Fi, i, Grid::Get(coarse.Fi, i) + inFi);
 			}
 		}
 	}
 }
 
 
+// Only the nodes around the old and new positions of the colliders are rewritten
+void Solver::MoveColliders()
+{
+	#pragma omp single
+	for (size_t c = 0; c < colliders.size(); c++)
+		colliders[c].Move(time);
+
+	for (int level = 0; level < (ADAPTIVE_GRID ? 2 : 1); level++)
+	{
+		Grid& g = LevelGrid(level);
+		for (size_t c = 0; c < colliders.size(); c++)
+			g.ClearColliders(colliders[c].X_min_old, colliders[c].X_max_old);
+		for (size_t c = 0; c < colliders.size(); c++)
+			g.RasterizeCollider((int)c, colliders[c]);
+	}
+}
+
+
 // Update node force and velocity
 void Solver::UpdateNodes()
 {
-	// Dynamic parallelization because not all the nodes are active
-	#pragma omp parallel for schedule (dynamic)
-	for (int i = 0; i < ilen; i++)
+	if (!colliders.empty())
+		MoveColliders();
+
+	UpdateGrid(grid);
+	if (ADAPTIVE_GRID)
+		UpdateGrid(coarse);
+}
+
+
+void Solver::UpdateGrid(Grid& g)
+{
+	// Only the tiles touched in P2G. Dynamic because tiles are not uniformly filled
+	#pragma omp for schedule (dynamic)
+	for (int a = 0; a < (int)g.ActiveTiles.size(); a++)
+		UpdateGridTile(g, g.ActiveTiles[a]);
+}
+
+
+void Solver::UpdateGridTile(Grid& g, const int t)
+{
+	int x0, x1, y0, y1;
+	g.TileRange(t, x0, x1, y0, y1);
+
+	for (int y = y0; y < y1; y++)
 	{
-		if (nodes[i].Mi > 0)
-		{	
-			// Finish updating velocity, force, and apply updated force
-			// (not done before because the loop was on particles)
-			nodes[i].Vi /= nodes[i].Mi;
-			nodes[i].Fi = DT * (-nodes[i].Fi / nodes[i].Mi + G);
-			nodes[i].Vi += nodes[i].Fi;
+		for (int x = x0; x < x1; x++)
+		{
+			size_t i = g.NodeIndex(x, y);
+			if (g.Mi[i] > 0)
+			{
+				// Finish updating velocity, force, and apply updated force
+				// (not done before because the loop was on particles)
+				Vector2f Vi = Grid::Get(g.Vi, i) / g.Mi[i];
+				Vector2f Fi = DT * (-Grid::Get(g.Fi, i) / g.Mi[i] + G);
+				Grid::Set(g.Vi, i, Vi + Fi);
+
+				// Apply collisions and frictions (only nodes near borders and colliders can collide)
+				if (g.BandIndex[i] < 0 && (g.ColliderIndex.empty() || g.ColliderIndex[i] < 0))
+				{
+					Grid::Set(g.Vi_col, i, Vi + Fi);
+					Grid::Set(g.Vi_fri, i, Vi + Fi);
+					continue;
+				}
 
-			// Apply collisions and frictions
-			nodes[i].NodeCollisions();
-			#if FRICTION
-			nodes[i].NodeFrictions();
-			#else
-			nodes[i].Vi_fri = nodes[i].Vi_col;
-			#endif
+				g.NodeCollisions(i);
+				if (MaterialTraits<Material>::FRICTION)
+					g.NodeFrictions(i);
+				else
+				{
+					g.Vi_fri[0][i] = g.Vi_col[0][i];
+					g.Vi_fri[1][i] = g.Vi_col[1][i];
+				}
+			}
 		}
 	}
 }
 
 
 // Transfer from Grid nodes to Particles
-void Solver::G2P()				
+void Solver::G2P()
 {
-	#pragma omp parallel for 
+	if (INTERPOLATION_MODE == 1)
+		G2P<1>();
+	else
+		G2P<2>();
+}
+
+
+// Tiled P2G: the particles are read tile by tile, from the scratchpad of the tile (their bins are
+// still valid). With the adaptive grid, particles may read another level than the one of their bin
+template <int INTERP>
+void Solver::G2P()
+{
+	if (P2G_MODE == 4 && !ADAPTIVE_GRID)
+	{
+		Scratchpad pad;									// One per thread
+
+		#pragma omp for schedule (dynamic)
+		for (int k = 0; k < (int)TileBins.size(); k++)
+		{
+			const int t = TileBins[k];
+
+			grid.LoadScratchpad<INTERP>(t, pad, grid.Vi_fri);
+			for (int q = CellStart[t]; q < CellStart[t + 1]; q++)
+				G2PParticle<INTERP>(CellParticles[q], &pad);
+		}
+		return;
+	}
+
+	#pragma omp for
 	for (int p = 0; p < plen; p++)
-	{		
-		// Index of bottom-left node closest to the particle
-		int node_base =
-			(X_GRID + 1) * static_cast<int>(particles[p].Xp[1] - Translation_xp[1])
-			+ static_cast<int>(particles[p].Xp[0] - Translation_xp[0]);
-
-		// Set velocity and velocity field to 0 for sum update
-		particles[p].Vp.setZeros();
-		particles[p].Bp.setZeros();
-
-		// Loop over all the close nodes (depend on interpolation through bni)
-		for (int y = bni; y < 3; y++) {
-			for (int x = bni; x < 3; x++)
-			{
-				// Index of the node
-				int node_id = node_base + x + (X_GRID + 1) * y;
-				
-				// Distance and weight
-				Vector2f dist = particles[p].Xp - nodes[node_id].Xi;
-				double Wip = getWip(dist);
-				
-				// Update velocity and velocity field (APIC)
-				particles[p].Vp += Wip * nodes[node_id].Vi_fri;
-				particles[p].Bp += Wip * (nodes[node_id].Vi_fri.outer_product(-dist));
-			}
+		G2PParticle<INTERP>(p);
+}
+
+
+template <int INTERP>
+void Solver::G2PParticle(const int p, const Scratchpad* pad)
+{
+	typedef Spline<INTERP> S;
+	Grid& g = LevelGrid(Level[p]);
+
+	// Index of bottom-left node closest to the particle
+	int x_base, y_base;
+	g.StencilBase<INTERP>(particles[p].Xp, x_base, y_base);
+
+	// Node velocities: the grid, or the scratchpad of the tile
+	const double* V[2] = { pad ? pad->V[0] : g.Vi_fri[0].data(), pad ? pad->V[1] : g.Vi_fri[1].data() };
+
+	// Set velocity and velocity field to 0 for sum update
+	particles[p].Vp.setZeros();
+	particles[p].Bp.setZeros();
+
+	// Separable weights
+	Vector2f dist_base = particles[p].Xp - g.NodePosition(x_base, y_base);
+	double W[2][4], dW[2][4];
+	StencilWeights<INTERP>(dist_base, g.h_inv, W, dW);
+
+	// Vectorized kernel: one stencil row per instruction
+	if (SIMD_KERNELS && (pad || g.ContiguousRows<INTERP>(x_base)))
+	{
+		size_t row[4];
+		if (pad)
+			StencilRows<INTERP>(*pad, x_base, y_base, row);
+		else
+			StencilRows<INTERP>(g, x_base, y_base, row);
+		G2PKernel<INTERP>(V[0], V[1], row, W, dist_base, g.h, particles[p].Vp, particles[p].Bp);
+		return;
+	}
+
+	// Loop over all the close nodes (compile-time bounds: unrolled)
+	for (int y = S::bni; y < 3; y++) {
+		for (int x = S::bni; x < 3; x++)
+		{
+			// Index of the node (wrapped on periodic sides, or in the scratchpad)
+			size_t node_id = pad ? pad->Index(x_base + x, y_base + y) : g.StencilNode(x_base + x, y_base + y);
+			
+			// Distance and weight
+			Vector2f dist = dist_base - Vector2f(x * g.h, y * g.h);
+			double Wip = W[0][x - S::bni] * W[1][y - S::bni];
+			
+			// Update velocity and velocity field (APIC)
+			Vector2f Vi_fri = Vector2f(V[0][node_id], V[1][node_id]);
+			particles[p].Vp += Wip * Vi_fri;
+			particles[p].Bp += Wip * (Vi_fri.outer_product(-dist));
 		}
 	}
 }
@@ -140,51 +930,311 @@ void Solver::G2P()
 // Update particle deformation data and position
 void Solver::UpdateParticles()
 {
-	#pragma omp parallel for 
-	for (int p = 0; p < plen; p++)
+	// Trace of T only (water), unless the refinement indicators need the whole velocity gradient
+	const bool trace = MaterialTraits<Material>::TRACE_ONLY && !ADAPTIVE_GRID;
+
+	if (INTERPOLATION_MODE == 1)
+		trace ? UpdateParticles<1, true>() : UpdateParticles<1, false>();
+	else
+		trace ? UpdateParticles<2, true>() : UpdateParticles<2, false>();
+}
+
+
+template <int INTERP, bool TRACE>
+void Solver::UpdateParticles()
+{
+	// Contiguous ranges of equal measured cost, timed block by block for the next step
+	if (LOAD_BALANCE)
+	{
+		#pragma omp single
+		partitioner.Balance(plen, omp_get_num_threads());
+
+		int p0, p1;
+		partitioner.Range(omp_get_thread_num(), plen, p0, p1);
+		for (int p = p0; p < p1; p += PARTITION_BLOCK)
+		{
+			double start = omp_get_wtime();
+			for (int q = p, end = std::min(p + PARTITION_BLOCK, p1); q < end; q++)
+				UpdateParticle<INTERP, TRACE>(q);
+			partitioner.Record(p / PARTITION_BLOCK, omp_get_wtime() - start);
+		}
+	}
+	else
 	{
-		// Index of bottom-left node closest to the particle
-		int node_base =
-			(X_GRID + 1) * static_cast<int>(particles[p].Xp[1] - Translation_xp[1])
-			+ static_cast<int>(particles[p].Xp[0] - Translation_xp[0]);
+		#pragma omp for nowait
+		for (int p = 0; p < plen; p++)
+			UpdateParticle<INTERP, TRACE>(p);
+	}
+
+	// Double-buffered grid: the back buffer is cleared in the same worksharing sequence
+	// (threads done with their particles start clearing, no separate reset pass)
+	if (DOUBLE_BUFFER_GRID)
+	{
+		#pragma omp for schedule (dynamic) nowait
+		for (int a = 0; a < (int)grid.ActiveTiles_back.size(); a++)
+			grid.ClearBackTile(a);
+
+		if (ADAPTIVE_GRID)
+		{
+			#pragma omp for schedule (dynamic) nowait
+			for (int a = 0; a < (int)coarse.ActiveTiles_back.size(); a++)
+				coarse.ClearBackTile(a);
+		}
+	}
 
-		// Save position to compute nodes-particle distances and update position in one loop
-		Vector2f Xp_buff = particles[p].Xp;
-		particles[p].Xp.setZeros();
-		//  T ~ nodal deformation
-		Matrix2f T;
+	// Implicit barrier: the step ends once all the particles are done
+	#pragma omp single
+	AdvanceTime();
+}
+
+
+template <int INTERP, bool TRACE>
+void Solver::UpdateParticle(const int p)
+{
+	typedef Spline<INTERP> S;
+
+	Grid& g = LevelGrid(Level[p]);
+
+	// Index of bottom-left node closest to the particle
+	int x_base, y_base;
+	g.StencilBase<INTERP>(particles[p].Xp, x_base, y_base);
+
+	// Save position to compute nodes-particle distances and update position in one loop
+	Vector2f Xp_buff = particles[p].Xp;
+	particles[p].Xp.setZeros();
+	//  T ~ nodal deformation
+	Matrix2f T;
+
+	// Separable weights
+	Vector2f dist_base = Xp_buff - g.NodePosition(x_base, y_base);
+	double W[2][4], dW[2][4];
+	StencilWeights<INTERP>(dist_base, g.h_inv, W, dW);
+
+	// Vectorized kernel: one stencil row per instruction
+	if (SIMD_KERNELS && g.ContiguousRows<INTERP>(x_base))
+	{
+		size_t row[4];
+		StencilRows<INTERP>(g, x_base, y_base, row);
+		UpdateKernel<INTERP, TRACE>(g.Vi_col[0].data(), g.Vi_col[1].data(), row, W, dW,
+			g.NodePosition(x_base, y_base), g.h, particles[p].Xp, T);
+	}
 
-		// Loop over all the close nodes (depend on interpolation through bni)
-		for (int y = bni; y < 3; y++) {
-			for (int x = bni; x < 3; x++)
+	// Loop over all the close nodes (compile-time bounds: unrolled)
+	else
+	{
+		for (int y = S::bni; y < 3; y++) {
+			for (int x = S::bni; x < 3; x++)
 			{
-				// Index of the node
-				int node_id = node_base + x + (X_GRID + 1) * y;
+				// Index of the node (wrapped on periodic sides)
+				size_t node_id = g.StencilNode(x_base + x, y_base + y);
 
 				// Distance and weight
-				Vector2f dist = Xp_buff - nodes[node_id].Xi;
-				double Wip = getWip(dist);
-				Vector2f dWip = getdWip(dist);
+				Vector2f Xi = g.NodePosition(x_base + x, y_base + y);
+				double Wip = W[0][x - S::bni] * W[1][y - S::bni];
+				Vector2f dWip = Vector2f(dW[0][x - S::bni] * W[1][y - S::bni], W[0][x - S::bni] * dW[1][y - S::bni]);
 
 				// Update position and nodal deformation
-				particles[p].Xp += Wip * (nodes[node_id].Xi + DT * nodes[node_id].Vi_col);
-				T += nodes[node_id].Vi_col.outer_product(dWip);
+				Vector2f Vi_col = Grid::Get(g.Vi_col, node_id);
+				particles[p].Xp += Wip * (Xi + DT * Vi_col);
+				if (TRACE)
+				{
+					T[0][0] += Vi_col[0] * dWip[0];
+					T[1][1] += Vi_col[1] * dWip[1];
+				}
+				else
+					T += Vi_col.outer_product(dWip);
 			}
 		}
-
-		// Update particle deformation gradient (elasticity, plasticity etc...)
-		particles[p].UpdateDeformation(T);
 	}
+
+	// Update particle deformation gradient (elasticity, plasticity etc...)
+	particles[p].UpdateDeformation(T);
+
+	// Particles leaving through a periodic side re-enter on the other side
+	grid.WrapPosition(particles[p].Xp);
+
+	// Particles that went through a boundary are pushed back, and none may leave the grid
+	grid.ClampParticle<INTERP>(particles[p].Xp, particles[p].Vp);
+	grid.ProjectParticle(particles[p].Xp, particles[p].Vp);
+
+	// Refinement indicators for the next step
+	if (ADAPTIVE_GRID)
+		refinement.Mark(particles[p].Xp, T);
 }
 
 
 // Reset active nodes data
 void Solver::ResetGrid()
 {
-	#pragma omp parallel for schedule (dynamic)
-	for (int i = 0; i < ilen; i++)
-		if (nodes[i].Mi > 0)
-			nodes[i].ResetNode();
+	// Double-buffered grid: the back buffer was cleared during UpdateParticles
+	if (DOUBLE_BUFFER_GRID)
+	{
+		#pragma omp single
+		{
+			grid.SwapBuffers();
+			if (ADAPTIVE_GRID)
+				coarse.SwapBuffers();
+		}
+		return;
+	}
+
+	grid.ResetGrid();
+	if (ADAPTIVE_GRID)
+		coarse.ResetGrid();
+}
+
+
+
+/* -----------------------------------------------------------------------
+|								TASK GRAPH								 |
+----------------------------------------------------------------------- */
+
+
+void Solver::TaskStep()
+{
+	const bool trace = MaterialTraits<Material>::TRACE_ONLY;
+
+	if (INTERPOLATION_MODE == 1)
+		trace ? TaskStep<1, true>() : TaskStep<1, false>();
+	else
+		trace ? TaskStep<2, true>() : TaskStep<2, false>();
+}
+
+
+// Instead of a barrier between phases, each tile waits for its own inputs only:
+//	P2G of bin b			(no dependency)
+//	Update of tile T		after the P2G of every bin whose scratchpad covers T
+//	G2P + update of bin b	after the update of every tile its scratchpad covers
+// Phases overlap across the domain: a dense region still scattering does not hold back the
+// G2P of the sparse regions around it. Bins are dealt out in contiguous ranges (neighbour bins
+// on the same thread), and a thread runs the tasks it releases first (see scheduler.h)
+template <int INTERP, bool TRACE>
+void Solver::TaskStep()
+{
+	#pragma omp single
+	{
+		plen = particles.size();
+		Level.resize(plen, 0);
+		Cell.resize(plen);
+		Base[0].resize(plen);
+		Base[1].resize(plen);
+	}
+
+	#pragma omp for
+	for (int p = 0; p < plen; p++)
+	{
+		particles[p].ConstitutiveModel();
+		BinParticle<INTERP>(p, true);
+	}
+
+	#pragma omp single
+	{
+		SortCells(true);
+		BuildTaskGraph<INTERP>();
+	}
+
+	// Node tasks read the collider bands
+	if (!colliders.empty())
+		MoveColliders();
+
+	Scratchpad pad;										// One per thread
+	const int thread = omp_get_thread_num();
+	Task task;
+	while (scheduler.Next(thread, task))
+	{
+		RunTask<INTERP, TRACE>(thread, task, pad);
+		scheduler.Done();
+	}
+
+	if (DOUBLE_BUFFER_GRID)
+	{
+		#pragma omp for schedule (dynamic) nowait
+		for (int a = 0; a < (int)grid.ActiveTiles_back.size(); a++)
+			grid.ClearBackTile(a);
+	}
+
+	// Tiles marked by the P2G tasks: reset at the next step
+	#pragma omp single
+	{
+		grid.BuildActiveTiles();
+		AdvanceTime();
+	}
+}
+
+
+// Counters are rebuilt each step from the non-empty bins: a tile waits for the bins writing it,
+// which its node task then releases
+template <int INTERP>
+void Solver::BuildTaskGraph()
+{
+	const int bins = (int)TileBins.size();
+	const int tiles = grid.X_TILES * grid.Y_TILES;
+
+	BuildTileUsers<INTERP>();
+	if (DETERMINISTIC_SUMS)
+		BinPads.resize(bins);
+
+	NodeDeps.resize(tiles);
+	G2PDeps.assign(BinTileCount.begin(), BinTileCount.end());
+
+	int node_tasks = 0;
+	for (int t = 0; t < tiles; t++)
+	{
+		NodeDeps[t] = TileUsersStart[t + 1] - TileUsersStart[t];
+		if (NodeDeps[t] > 0)
+			node_tasks++;
+	}
+
+	scheduler.Reset(2 * bins + node_tasks);
+	const int queues = (int)scheduler.queues.size();
+	for (int k = 0; k < bins; k++)
+		scheduler.Push((int)((long long)k * queues / bins), { P2G_TASK, k });
+}
+
+
+template <int INTERP, bool TRACE>
+void Solver::RunTask(const int thread, const Task& task, Scratchpad& pad)
+{
+	if (task.type == P2G_TASK)
+	{
+		// Deterministic sums: the scratchpad is kept, added by the node tasks
+		const int t = TileBins[task.id];
+		Scratchpad& target = DETERMINISTIC_SUMS ? BinPads[task.id] : pad;
+		grid.LoadScratchpad<INTERP>(t, target);
+		for (int q = CellStart[t]; q < CellStart[t + 1]; q++)
+			ScatterParticle<INTERP, 4>(CellParticles[q], &target);
+		if (!DETERMINISTIC_SUMS)
+			grid.FlushScratchpad<INTERP>(t, pad);
+
+		// The flush is the last write of this bin to its tiles
+		for (int j = 0; j < BinTileCount[task.id]; j++)
+		{
+			int tile = BinTiles[9 * (size_t)task.id + j];
+			if (Scheduler::Release(NodeDeps[tile]))
+				scheduler.Push(thread, { NODE_TASK, tile });
+		}
+	}
+	else if (task.type == NODE_TASK)
+	{
+		const int users = TileUsersStart[task.id + 1] - TileUsersStart[task.id];
+		if (DETERMINISTIC_SUMS)
+			grid.SumScratchpads(task.id, BinPads, &TileUsers[TileUsersStart[task.id]], users);
+		UpdateGridTile(grid, task.id);
+
+		for (int u = TileUsersStart[task.id]; u < TileUsersStart[task.id + 1]; u++)
+			if (Scheduler::Release(G2PDeps[TileUsers[u]]))
+				scheduler.Push(thread, { G2P_TASK, TileUsers[u] });
+	}
+	else
+	{
+		const int t = TileBins[task.id];
+		grid.LoadScratchpad<INTERP>(t, pad, grid.Vi_fri);
+		for (int q = CellStart[t]; q < CellStart[t + 1]; q++)
+		{
+			G2PParticle<INTERP>(CellParticles[q], &pad);
+			UpdateParticle<INTERP, TRACE>(CellParticles[q]);
+		}
+	}
 }
 
 
@@ -200,11 +1250,14 @@ void Solver::Draw()
 	// Draw borders
 	for (size_t b = 0; b < blen; b++)
 		borders[b].DrawBorder();
+	for (size_t c = 0; c < colliders.size(); c++)
+		colliders[c].DrawCollider();
 
 	// Draw nodes
 	#if DRAW_NODES
-	for (size_t i = 0; i < ilen; i++)
-		nodes[i].DrawNode();
+	grid.DrawNodes();
+	if (ADAPTIVE_GRID)
+		refinement.DrawRefinement();
 	#endif
 
 	// Draw particles
@@ -218,6 +1271,9 @@ void Solver::WriteToFile(int frame)
 {
 	std::ofstream output;
 	std::string fileName = "out/ply/frame_" + std::to_string(frame) + ".ply";
+	// One point cloud per slab in a multi-process run
+	if (domain.ranks > 1)
+		fileName = "out/ply/frame_" + std::to_string(frame) + "_" + std::to_string(domain.rank) + ".ply";
 
 	output.open(fileName);
 	output << "ply" << std::endl;
@@ -230,7 +1286,8 @@ void Solver::WriteToFile(int frame)
 	output << "property list uint int vertex_indices" << std::endl;
 	output << "end_header" << std::endl;
 
-	for (int p = 0; p < plen; p++)
+	// Particles migrated since the last transfer: current size, not plen
+	for (size_t p = 0; p < particles.size(); p++)
 	{
 		std::string coordinates =
 			std::to_string(particles[p].Xp[0]) + " " +
@@ -240,5 +1297,6 @@ void Solver::WriteToFile(int frame)
 	}
 
 	output.close();
-	std::cout << " Frame #: " << frame << std::endl;
+	if (domain.rank == 0)
+		std::cout << " Frame #: " << frame << std::endl;
 }
@@ -5,8 +5,15 @@
 #include <iomanip>
 #include <string>
 
+#include <omp.h>
+
 #include "particle.h"
-#include "node.h"
+#include "grid.h"
+#include "refinement.h"
+#include "simd.h"
+#include "scheduler.h"
+#include "partitioner.h"
+#include "domain.h"
 
 /* The solver class is the link between particles and nodes.
 Transfers and updates are executed on solver instances. */
@@ -17,8 +24,35 @@ public:
 
 	/* Data */
 	std::vector<Border> borders;
-	std::vector<Node> nodes;
-	std::vector<Material> particles;
+	std::vector<Collider> colliders;				// Moving kinematic solids
+	double time;									// Simulated time (colliders motion)
+	double stop_time;								// Adaptive time-step: next frame time, hit exactly
+	bool on_stop;									// (the current step ends on it)
+	double max_speed, max_wave;						// Largest particle and wave speeds (ChooseTimeStep)
+	Grid grid;										// Base grid (fine level)
+	Grid coarse;									// Coarse level (adaptive grid only)
+	Refinement refinement;
+	std::vector<unsigned char> Level;				// Grid level read by each particle: [0] fine - [1] coarse
+	std::vector<int> Cell;							// Cell of each particle: stencil base node on its P2G level (or tile)
+	std::vector<int> CellStart;						// Particles sorted by cell (counting sort, both levels)
+	std::vector<int> CellParticles;
+	std::vector<int> TileBins;						// Tiled transfers: non-empty bins (particles binned by tile)
+	std::vector<int> Base[2];						// Stencil base of each particle on its P2G level
+	std::vector<Matrix2f> Cp;						// Gather P2G: APIC affine matrix of each particle
+	std::vector<double> Weights;					// Gather P2G: stencil weights of each particle (W, dW: 16)
+	std::vector<unsigned char> RestrictActive;		// Coarse tiles receiving restricted data
+	std::vector<int> RestrictTiles;
+	Scheduler scheduler;							// Task graph step (see TaskStep)
+	Partitioner partitioner;						// Cost-driven particle update (LOAD_BALANCE)
+	Domain domain;									// Slab of this process (multi-process run)
+	std::vector<int> NodeDeps;						// Task graph: P2G tasks left before the update of each tile
+	std::vector<int> G2PDeps;						// Node tasks left before the G2P of each tile bin
+	std::vector<int> BinTiles;						// Tiles of the scratchpad of each tile bin (9 slots per bin)
+	std::vector<int> BinTileCount;
+	std::vector<int> TileUsersStart;				// Tile bins whose scratchpad covers each tile (in bin order)
+	std::vector<int> TileUsers;
+	std::vector<Scratchpad> BinPads;				// Deterministic sums: scratchpad kept by each tile bin
+	NumaVector<Material> particles;
 
 	size_t ilen, blen, plen;
 
@@ -26,112 +60,106 @@ public:
 
 	/* Constructors */
 	Solver() {};
-	Solver(const std::vector<Border>& inBorders, const std::vector<Node>& inNodes,
-		const std::vector<Material>& inParticles);
+	Solver(const std::vector<Border>& inBorders, const std::vector<Collider>& inColliders,
+		const Grid& inGrid, const std::vector<Material>& inParticles, const Domain& inDomain = Domain(),
+		const int inThreads = 0);						// Threads running its steps (0: omp_get_max_threads)
 	~Solver() {};
 
 
 
 	/* Functions */
+	void Step();									// One time step, in a single parallel region
+
+	// The phases of a step are worksharing constructs (omp for / single) without their own
+	// parallel region: they are called by all the threads of the team of Step
+	// Transfers are templates on the interpolation type (INTERP, see spline.h) and on the arithmetic
+	// of the material (MaterialTraits): the functions without template argument select them
 	void P2G();										// Transfer from Particles to Grid nodes
+	template <int INTERP>
+	void P2G();
+	template <int INTERP, int MODE>
+	void ScatterParticle(const int p,				// P2G of one particle (MODE: P2G_MODE)
+		Scratchpad* pad = nullptr);					// (scratchpad of its tile, MODE 4)
+	int P2GLevel(const int p) const;				// Grid level of the P2G of a particle
+	template <int INTERP>
+	void BinParticle(const int p,					// Cell of a particle
+		const bool tiles = false);					// (or its tile)
+	void SortCells(const bool tiles = false);		// Sort the particles by cell (or by tile)
+	template <int INTERP>
+	void ColoredP2G();								// P2G by colored particle blocks
+	template <int INTERP>
+	void GatherP2G();								// P2G by node, from the particles of the nearby cells
+	template <int INTERP>
+	void TiledP2G();								// P2G by tile, in the scratchpad of the thread
+	template <int INTERP>
+	void BuildTileUsers();							// Tiles of the scratchpad of each bin, bins of each tile
+	void MoveColliders();							// Move colliders and rasterize them where they moved
 	void UpdateNodes();
 	void G2P();										// Transfer from Grid nodes to Particles
+	template <int INTERP>
+	void G2P();
+	template <int INTERP>
+	void G2PParticle(const int p,					// G2P of one particle
+		const Scratchpad* pad = nullptr);			// (from the scratchpad of its tile)
 	void UpdateParticles();
+	template <int INTERP, bool TRACE>
+	void UpdateParticles();							// (TRACE: diagonal of T only, see MaterialTraits)
+	template <int INTERP, bool TRACE>
+	void UpdateParticle(const int p);				// Position and deformation of one particle
 	void ResetGrid();
-
-	void Draw();									// Draw particles, border and nodes (if selected)
-	void WriteToFile(int frame);					// Write point cloud coordinates to .ply file (Houdini)
-
-
-
-	/* Static functions */
-	#if INTERPOLATION == 1
-	static double Bspline(double x)					// Cubic Bspline
+	void ChooseTimeStep();							// CFL time-step (ADAPTIVE_TIME_STEP)
+	void AdvanceTime();								// time += DT (or the stop time)
+
+	void TaskStep();								// P2G, nodes, G2P and particles as a task graph over tiles
+	template <int INTERP, bool TRACE>
+	void TaskStep();
+	template <int INTERP>
+	void BuildTaskGraph();							// Dependency counters and initial tasks (one thread)
+	template <int INTERP, bool TRACE>
+	void RunTask(const int thread, const Task& task, Scratchpad& pad);
+
+	Grid& LevelGrid(const int level)				// Grid of a level
 	{
-		double W;
-		x = fabs(x);
-
-		if (x < 1)
-			W = (x*x*x / 2.0 - x * x + 2 / 3.0);
-
-		else if (x < 2)
-			W = (2 - x)*(2 - x)*(2 - x) / 6.0;
-
-		else
-			W = 0;
-
-		return W;
+		return level ? coarse : grid;
 	}
+	void Restrict();								// Restrict fine grid data to the coarse grid
+	void UpdateGrid(Grid& g);						// UpdateNodes on one level
+	void UpdateGridTile(Grid& g, const int t);		// (on one tile)
 
+	void Draw();									// Draw particles, borders, colliders and nodes (if selected)
+	void WriteToFile(int frame);					// Write point cloud coordinates to .ply file (Houdini)
 
-	static double dBspline(double x)					// Cubic Bspline derivative
-	{
-		double dW;
-		double x_abs;
-		x_abs = fabs(x);
-
-		if (x_abs < 1)
-			dW = 1.5 * x * x_abs - 2.0 * x;
-
-		else if (x_abs < 2)
-			dW = -x * x_abs / 2.0 + 2 * x - 2 * x / x_abs;
-
-		else
-			dW = 0;
-
-		return dW;
-	}
-
-
-	#elif INTERPOLATION == 2
-	static double Bspline(double x)
-	{
-		double W;
-		x = fabs(x);
-
-		if (x < 0.5)
-			W = -x * x + 3 / 4.0;
-
-		else if (x < 1.5)
-			W = x * x / 2.0 - 3 * x / 2.0 + 9 / 8.0;
-		
-		else
-			W = 0;
-
-		return W;
-	}
 
 
-	static double dBspline(double x)
+	/* Static functions */
+	template <int INTERP>
+	static void StencilWeights(const Vector2f& dist_base,	// Weights of a particle stencil, node (x, y) at
+		const double h_inv,							// index (x - bni, y - bni). dist_base: particle - base
+		double W[2][4], double dW[2][4])			// node (physical units), gradients in physical units
 	{
-		double dW;
-		double x_abs;
-		x_abs = fabs(x);
-
-		if (x_abs < 0.5)
-			dW = -2.0 * x;
-		
-		else if (x_abs < 1.5)
-			dW = x - 3 / 2.0 * x / x_abs;
-		
-		else
-			dW = 0;
-
-		return dW;
+		for (int d = 0; d < 2; d++)
+		{
+			Spline<INTERP>::Weights1D(dist_base[d] * h_inv, W[d], dW[d]);
+			for (int k = 0; k < 4; k++)
+				dW[d][k] *= h_inv;
+		}
 	}
-	#endif
-
 
-	static double getWip(const Vector2f& dist)		// 2D weight
+	template <int INTERP>
+	static void StencilRows(const Grid& g,			// Index of the first node of each stencil row
+		const int x_base, const int y_base, size_t row[4])
 	{
-		return Bspline(dist[0]) * Bspline(dist[1]);
+		const int bni = Spline<INTERP>::bni;
+		for (int j = 0; j < Spline<INTERP>::NODES; j++)
+			row[j] = g.StencilNode(x_base + bni, y_base + bni + j);
 	}
 
-
-	static Vector2f getdWip(const Vector2f& dist)	// 2D weight gradient
+	template <int INTERP>
+	static void StencilRows(const Scratchpad& pad,	// (in a scratchpad)
+		const int x_base, const int y_base, size_t row[4])
 	{
-		return Vector2f(
-			dBspline(dist[0]) * Bspline(dist[1]),
-			Bspline(dist[0]) * dBspline(dist[1]));
+		const int bni = Spline<INTERP>::bni;
+		for (int j = 0; j < Spline<INTERP>::NODES; j++)
+			row[j] = pad.Index(x_base + bni, y_base + bni + j);
 	}
 };
@@ -0,0 +1,67 @@
+#pragma once
+
+/* B-spline interpolation functions. The transfer kernels are templates on the interpolation
+type INTERP ([1] Cubic - [2] Quadratic, as the INTERPOLATION option): stencil bounds are
+compile-time constants and both kernels are in the binary, selected at runtime (-interpolation).
+
+The stencil of a particle covers nodes base + bni to base + 2 on each axis, base being the
+bottom-left node given by floor(Xp / h - Translation_xp). The 2D weight of node (x, y) of a
+stencil is W[0][x - bni] * W[1][y - bni]: Weights1D gives the 1D weights and derivatives of one
+axis, t being the distance particle - base node in cells. */
+
+template <int INTERP>
+struct Spline;
+
+
+template <>
+struct Spline<1>												// Cubic
+{
+	static constexpr int bni = -1;								// First stencil node (from the base node)
+	static constexpr int NODES = 4;								// Stencil width
+	static constexpr double CUB = 2.0;							// Range of the interpolation function (cells)
+	static constexpr double Translation_xp = 0.0;				// Offset (cells) of the stencil base
+	static constexpr double Dp_scal = 3.0;						// Dp^-1 = Dp_scal / h^2
+
+	static void Weights1D(const double t,						// Nodes base - 1 to base + 2 (t in [0, 1))
+		double W[4], double dW[4])
+	{
+		double s = 1.0 - t;
+
+		W[0] = s * s * s / 6.0;
+		W[1] = 0.5 * t * t * t - t * t + 2 / 3.0;
+		W[2] = 0.5 * s * s * s - s * s + 2 / 3.0;
+		W[3] = t * t * t / 6.0;
+
+		dW[0] = -0.5 * s * s;
+		dW[1] = 1.5 * t * t - 2.0 * t;
+		dW[2] = -1.5 * s * s + 2.0 * s;
+		dW[3] = 0.5 * t * t;
+	}
+};
+
+
+template <>
+struct Spline<2>												// Quadratic
+{
+	static constexpr int bni = 0;
+	static constexpr int NODES = 3;
+	static constexpr double CUB = 1.5;
+	static constexpr double Translation_xp = 0.5;
+	static constexpr double Dp_scal = 4.0;
+
+	static void Weights1D(const double t,						// Nodes base to base + 2 (t in [0.5, 1.5))
+		double W[4], double dW[4])								// (4th weight padded with 0)
+	{
+		double a = 1.5 - t, b = t - 1.0, c = t - 0.5;
+
+		W[0] = 0.5 * a * a;
+		W[1] = 0.75 - b * b;
+		W[2] = 0.5 * c * c;
+		W[3] = 0.0;
+
+		dW[0] = -a;
+		dW[1] = -2.0 * b;
+		dW[2] = c;
+		dW[3] = 0.0;
+	}
+};
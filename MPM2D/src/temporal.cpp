@@ -0,0 +1,116 @@
+#include "temporal.h"
+
+#include <algorithm>
+
+/* Constructors */
+// Strips are fixed: their grids (border band, collider arrays) are built once
+TimeBlocks::TimeBlocks(const Solver& s, const int inDepth)
+{
+	depth = inDepth;
+
+	// Dependency cone of a step: two stencil reaches and a cell of motion, plus the rounding of
+	// the stencil bases
+	int halo = static_cast<int>(ceil(depth * (2 * CUB + 2)));
+	halo = (halo + TILE - 1) / TILE * TILE;
+
+	for (int c0 = 0; c0 <= X_GRID; c0 += TIME_BLOCK_WIDTH)
+	{
+		int c1 = std::min(c0 + TIME_BLOCK_WIDTH, X_GRID + 1);
+		int n0 = std::max(c0 - halo, 0), n1 = std::min(c1 - 1 + halo, X_GRID);
+
+		Core.push_back(c0);
+		First.push_back(n0);
+		Grid inGrid = Grid(n1 - n0, Y_GRID, H, s.borders, 0, n0);
+		strips.push_back(new Solver(s.borders, s.colliders, inGrid, std::vector<Material>(), Domain(), 1));
+	}
+	Core.push_back(X_GRID + 1);
+	Source.resize(strips.size());
+}
+
+
+TimeBlocks::~TimeBlocks()
+{
+	for (size_t k = 0; k < strips.size(); k++)
+		delete strips[k];
+}
+
+
+
+/* -----------------------------------------------------------------------
+|								ADVANCE									 |
+----------------------------------------------------------------------- */
+
+
+// Each strip runs its steps in the parallel loop, with one thread (the parallel region of
+// Solver::Step is nested, hence inactive)
+void TimeBlocks::Advance(Solver& s, const int steps)
+{
+	const int plen = (int)s.particles.size();
+	const int slen = (int)strips.size();
+	const double translation = (INTERPOLATION_MODE == 1) ? Spline<1>::Translation_xp : Spline<2>::Translation_xp;
+	const int bni = (INTERPOLATION_MODE == 1) ? Spline<1>::bni : Spline<2>::bni;
+
+	Base.resize(plen);
+
+	#pragma omp parallel for
+	for (int p = 0; p < plen; p++)
+		Base[p] = static_cast<int>(floor(s.particles[p].Xp[0] * H_INV - translation));
+
+	// Particles sorted by column (bases outside the domain in its first or last column): a strip
+	// only reads the columns of its grid, not all the particles
+	ColumnStart.assign(X_GRID + 2, 0);
+	for (int p = 0; p < plen; p++)
+		ColumnStart[std::min(std::max(Base[p], 0), X_GRID) + 1]++;
+	for (int c = 0; c <= X_GRID; c++)
+		ColumnStart[c + 1] += ColumnStart[c];
+
+	ColumnParticles.resize(plen);
+	std::vector<int> next(ColumnStart.begin(), ColumnStart.end() - 1);
+	for (int p = 0; p < plen; p++)
+		ColumnParticles[next[std::min(std::max(Base[p], 0), X_GRID)]++] = p;
+
+	// Particles whose stencil is inside the grid of the strip, in their order in the simulation
+	// (same sums as without blocking). All the strips are filled before any particle is written back
+	#pragma omp parallel for schedule (dynamic)
+	for (int k = 0; k < slen; k++)
+	{
+		Solver& strip = *strips[k];
+		const int n0 = First[k], n1 = First[k] + strip.grid.nx;
+		const int c0 = std::min(std::max(n0 - bni, 0), X_GRID), c1 = std::min(std::max(n1 - 2, 0), X_GRID);
+
+		Source[k].clear();
+		for (int q = ColumnStart[c0]; q < ColumnStart[c1 + 1]; q++)
+		{
+			int p = ColumnParticles[q];
+			if (Base[p] + bni >= n0 && Base[p] + 2 <= n1)
+				Source[k].push_back(p);
+		}
+		std::sort(Source[k].begin(), Source[k].end());
+
+		strip.particles.clear();
+		for (size_t q = 0; q < Source[k].size(); q++)
+			strip.particles.push_back(s.particles[Source[k][q]]);
+	}
+
+	#pragma omp parallel for schedule (dynamic)
+	for (int k = 0; k < slen; k++)
+	{
+		Solver& strip = *strips[k];
+		strip.time = s.time;
+		for (int n = 0; n < steps; n++)
+			strip.Step();
+
+		// Particles that started in the core (particles keep their order in a step)
+		for (size_t q = 0; q < Source[k].size(); q++)
+		{
+			int p = Source[k][q];
+			if (Base[p] >= Core[k] && Base[p] < Core[k + 1])
+				s.particles[p] = strip.particles[q];
+		}
+	}
+
+	// The grid of s is not used: only its particles, time and colliders (drawing) move
+	s.plen = plen;
+	s.time = strips[0]->time;
+	s.colliders = strips[0]->colliders;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "solver.h"
+
+/* Temporal blocking: several steps are advanced strip by strip instead of step by step over the
+whole domain. The domain is cut in strips of TIME_BLOCK_WIDTH cells along x, each with its own
+solver on a grid covering the strip (core) and a halo on both sides. For a block of k steps, a
+strip copies the particles of its core and of its halo, then runs the k steps on its small grid
+(cache resident) with one thread. In a step, a particle only reads nodes within a stencil reach,
+written by particles within a stencil reach, and moves less than a cell: after k steps the core
+particles are exact as long as the halo is k (2 CUB + 2) cells wide. The halo particles are
+computed redundantly (their copies are dropped), the core particles are written back.
+Strips run in parallel, one per thread. Halos are rounded up to whole tiles: strip tiles line up
+with the tiles of the domain, and the deterministic sums are the same as without blocking. */
+
+class TimeBlocks
+{
+public:
+
+	/* Data */
+	std::vector<Solver*> strips;							// Solver of each strip (core and halo)
+	std::vector<int> Core;									// Stencil bases of the core of strip k: [Core[k], Core[k + 1])
+	std::vector<int> First;									// First node of the grid of each strip
+	std::vector<std::vector<int>> Source;					// Index in the simulation of each particle of a strip
+	std::vector<int> Base;									// Stencil base (x) of each particle of the simulation
+	std::vector<int> ColumnStart;							// Particles sorted by stencil base column (counting sort)
+	std::vector<int> ColumnParticles;
+	int depth;												// Steps per block (at most)
+
+
+
+	/* Constructors */
+	TimeBlocks() : depth(1) {};
+	TimeBlocks(const Solver& s, const int inDepth);
+	TimeBlocks(const TimeBlocks&) = delete;					// Strips own their solvers
+	~TimeBlocks();
+
+
+
+	/* Functions */
+	void Advance(Solver& s, const int steps);				// steps (<= depth) steps of the simulation s
+};
@@ -0,0 +1,308 @@
+#include "transport.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if defined(MPM_MPI)
+#include <mpi.h>
+#endif
+
+
+static void Fail(const char* what)
+{
+	std::cerr << "Transport: " << what << " (" << strerror(errno) << ")" << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+
+
+/* -----------------------------------------------------------------------
+|							SINGLE PROCESS								 |
+----------------------------------------------------------------------- */
+
+
+void Transport::SendRecv(const int dest, const std::vector<char>&, const int src, std::vector<char>& in)
+{
+	if (dest >= 0 || src >= 0)
+	{
+		std::cerr << "Transport: no other process to exchange with" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	in.clear();
+}
+
+
+// Gathered and summed on rank 0 in rank order (same result on every process), then sent back
+double Transport::Sum(const double x)
+{
+	if (size == 1)
+		return x;
+
+	std::vector<char> out(sizeof(double)), in;
+	double total = x;
+
+	if (rank == 0)
+	{
+		for (int r = 1; r < size; r++)
+		{
+			double y;
+			SendRecv(-1, out, r, in);
+			memcpy(&y, in.data(), sizeof(double));
+			total += y;
+		}
+
+		memcpy(out.data(), &total, sizeof(double));
+		for (int r = 1; r < size; r++)
+			SendRecv(r, out, -1, in);
+	}
+	else
+	{
+		memcpy(out.data(), &x, sizeof(double));
+		SendRecv(0, out, -1, in);
+		SendRecv(-1, out, 0, in);
+		memcpy(&total, in.data(), sizeof(double));
+	}
+
+	return total;
+}
+
+
+
+/* -----------------------------------------------------------------------
+|							UNIX SOCKETS								 |
+----------------------------------------------------------------------- */
+
+
+#if !defined(_WIN32)
+
+// One socket pair per pair of processes, created before the fork: each process keeps its end
+SocketTransport::SocketTransport(const int ranks)
+{
+	size = ranks;
+	rank = 0;
+
+	std::vector<int> ends(2 * (size_t)ranks * ranks, -1);		// Ends of the pair (i, j), i < j
+	for (int i = 0; i < ranks; i++)
+		for (int j = i + 1; j < ranks; j++)
+			if (socketpair(AF_UNIX, SOCK_STREAM, 0, &ends[2 * ((size_t)i * ranks + j)]) != 0)
+				Fail("socketpair");
+
+	// Buffered output would be printed by every process
+	std::cout.flush();
+	fflush(nullptr);
+
+	for (int r = 1; r < ranks; r++)
+	{
+		pid_t pid = fork();
+		if (pid < 0)
+			Fail("fork");
+		if (pid == 0)
+		{
+			rank = r;
+			break;
+		}
+	}
+
+	sockets.assign(ranks, -1);
+	for (int i = 0; i < ranks; i++)
+		for (int j = i + 1; j < ranks; j++)
+		{
+			int a = ends[2 * ((size_t)i * ranks + j)], b = ends[2 * ((size_t)i * ranks + j) + 1];
+			if (rank == i)
+			{
+				sockets[j] = a;
+				close(b);
+			}
+			else if (rank == j)
+			{
+				sockets[i] = b;
+				close(a);
+			}
+			else
+			{
+				close(a);
+				close(b);
+			}
+		}
+
+	// Non-blocking: a send never waits for the peer to read while data is coming in
+	for (int r = 0; r < ranks; r++)
+		if (sockets[r] >= 0)
+			fcntl(sockets[r], F_SETFL, fcntl(sockets[r], F_GETFL) | O_NONBLOCK);
+}
+
+
+SocketTransport::~SocketTransport()
+{
+	for (size_t r = 0; r < sockets.size(); r++)
+		if (sockets[r] >= 0)
+			close(sockets[r]);
+
+	// The first process waits for the others
+	if (rank == 0)
+		while (wait(nullptr) > 0);
+}
+
+
+// Messages are a 64-bit size then the data. Both directions progress in the same poll loop
+void SocketTransport::SendRecv(const int dest, const std::vector<char>& out, const int src, std::vector<char>& in)
+{
+	uint64_t out_size = out.size(), in_size = 0;
+	size_t sent = 0, send_total = (dest >= 0) ? sizeof(uint64_t) + out.size() : 0;
+	size_t got = 0, recv_total = (src >= 0) ? sizeof(uint64_t) : 0;
+	const size_t head = sizeof(uint64_t);
+	in.clear();
+
+	while (sent < send_total || got < recv_total)
+	{
+		pollfd fds[2];
+		int nfds = 0, send_fd = -1, recv_fd = -1;
+		if (sent < send_total)
+		{
+			send_fd = nfds;
+			fds[nfds++] = { sockets[dest], POLLOUT, 0 };
+		}
+		if (got < recv_total)
+		{
+			recv_fd = nfds;
+			fds[nfds++] = { sockets[src], POLLIN, 0 };
+		}
+
+		if (poll(fds, nfds, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			Fail("poll");
+		}
+
+		if (send_fd >= 0 && fds[send_fd].revents)
+		{
+			const char* data = (sent < head) ? (const char*)&out_size + sent : out.data() + (sent - head);
+			size_t len = (sent < head) ? head - sent : send_total - sent;
+
+			ssize_t n = send(sockets[dest], data, len, MSG_NOSIGNAL);
+			if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				Fail("send");
+			sent += (n > 0) ? n : 0;
+		}
+
+		if (recv_fd >= 0 && fds[recv_fd].revents)
+		{
+			char* data = (got < head) ? (char*)&in_size + got : in.data() + (got - head);
+			size_t len = (got < head) ? head - got : recv_total - got;
+
+			ssize_t n = recv(sockets[src], data, len, 0);
+			if (n == 0)
+			{
+				std::cerr << "Transport: process " << src << " left" << std::endl;
+				exit(EXIT_FAILURE);
+			}
+			if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				Fail("recv");
+			got += (n > 0) ? n : 0;
+
+			// Size received: now the data
+			if (got == head && recv_total == head)
+			{
+				in.resize(in_size);
+				recv_total = head + in_size;
+			}
+		}
+	}
+}
+
+#endif
+
+
+
+/* -----------------------------------------------------------------------
+|									MPI									 |
+----------------------------------------------------------------------- */
+
+
+#if defined(MPM_MPI)
+
+static void FinalizeMpi()
+{
+	MPI_Finalize();
+}
+
+
+// Exchanges are made by one thread at a time, not always the main one (omp single in Solver::Step)
+MpiTransport::MpiTransport()
+{
+	int provided;
+	MPI_Init_thread(nullptr, nullptr, MPI_THREAD_SERIALIZED, &provided);
+	if (provided < MPI_THREAD_SERIALIZED)
+	{
+		std::cerr << "MPI does not support calls from several threads (MPI_THREAD_SERIALIZED)" << std::endl;
+		MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+	}
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+	// The simulation loop has no end: finalized when the process exits
+	atexit(FinalizeMpi);
+}
+
+
+MpiTransport::~MpiTransport() {}
+
+
+void MpiTransport::SendRecv(const int dest, const std::vector<char>& out, const int src, std::vector<char>& in)
+{
+	int to = (dest >= 0) ? dest : MPI_PROC_NULL, from = (src >= 0) ? src : MPI_PROC_NULL;
+	long long out_size = out.size(), in_size = 0;
+
+	MPI_Sendrecv(&out_size, 1, MPI_LONG_LONG, to, 0, &in_size, 1, MPI_LONG_LONG, from, 0,
+		MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	in.resize((src >= 0) ? (size_t)in_size : 0);
+	MPI_Sendrecv(out.data(), (int)out.size(), MPI_CHAR, to, 1, in.data(), (int)in.size(), MPI_CHAR, from, 1,
+		MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+}
+
+
+double MpiTransport::Sum(const double x)
+{
+	double total;
+	MPI_Allreduce(&x, &total, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	return total;
+}
+
+#endif
+
+
+
+/* -----------------------------------------------------------------------
+|								START									 |
+----------------------------------------------------------------------- */
+
+
+Transport* StartTransport()
+{
+	#if defined(MPM_MPI)
+	return new MpiTransport();
+	#else
+	if (PROCESSES > 1)
+	{
+		#if defined(_WIN32)
+		std::cerr << "Multi-process runs need MPI on Windows (build with MPM_MPI)" << std::endl;
+		exit(EXIT_FAILURE);
+		#else
+		return new SocketTransport(PROCESSES);
+		#endif
+	}
+	return new Transport();
+	#endif
+}
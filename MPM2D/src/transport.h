@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+
+#include "parameters.h"
+
+/* Message passing between the processes of a multi-process run (see domain.h). The base class is
+the single-process case. Implementations:
+	SocketTransport		processes forked on one machine, connected by Unix socket pairs (-ranks n)
+	MpiTransport		MPI, across machines (build with MPM_MPI, run with mpirun)
+Exchanges are pairwise and symmetric (send to one rank while receiving from another), so that two
+neighbours sending to each other at the same time never wait on each other. */
+
+class Transport
+{
+public:
+
+	/* Data */
+	int rank;												// This process
+	int size;												// Number of processes
+
+
+
+	/* Constructors */
+	Transport() : rank(0), size(1) {};
+	virtual ~Transport() {};
+
+
+
+	/* Functions */
+	virtual void SendRecv(const int dest, const std::vector<char>& out,	// Send to dest and receive from
+		const int src, std::vector<char>& in);				// src at the same time (-1: no such side)
+	virtual double Sum(const double x);						// Sum over all the processes
+};
+
+
+#if !defined(_WIN32)
+class SocketTransport : public Transport
+{
+public:
+
+	/* Data */
+	std::vector<int> sockets;								// Socket connected to each other process (-1: self)
+
+
+
+	/* Constructors */
+	SocketTransport(const int ranks);						// Forks ranks - 1 processes
+	~SocketTransport();
+
+
+
+	/* Functions */
+	void SendRecv(const int dest, const std::vector<char>& out,
+		const int src, std::vector<char>& in);
+};
+#endif
+
+
+#if defined(MPM_MPI)
+class MpiTransport : public Transport
+{
+public:
+
+	/* Constructors */
+	MpiTransport();
+	~MpiTransport();
+
+
+
+	/* Functions */
+	void SendRecv(const int dest, const std::vector<char>& out,
+		const int src, std::vector<char>& in);
+	double Sum(const double x);
+};
+#endif
+
+
+
+/* Transport of the run: MPI when built with it, sockets with -ranks > 1, else single process.
+Called before any OpenMP region (forked processes do not inherit the OpenMP threads) */
+Transport* StartTransport();